@@ -0,0 +1,53 @@
+#include "ArchivePrefetchPolicy.h"
+
+ArchivePrefetchPolicy::ArchivePrefetchPolicy(double threshold, size_t minRanges, uint64_t requestOverhead)
+    : threshold_(threshold), minRanges_(minRanges), requestOverhead_(requestOverhead) {
+}
+
+bool ArchivePrefetchPolicy::Record(const std::string& archive, size_t ranges, uint64_t bytes,
+                                   const SizeLookup& archiveSize) {
+    if (threshold_ <= 0)
+        return false;
+
+    std::unique_lock lock(mutex_);
+    auto& usage = usage_[archive];
+    if (usage.mode != Mode::Ranges)
+        return usage.mode == Mode::Whole;
+
+    usage.ranges += ranges;
+    usage.bytes += bytes;
+    if (usage.ranges < minRanges_)
+        return false;
+
+    // Looked up without the lock, it is a network round trip. Map nodes stay put, so usage remains valid.
+    if (!usage.sizeLookedUp) {
+        usage.sizeLookedUp = true;
+        lock.unlock();
+        uint64_t size = archiveSize(archive);
+        lock.lock();
+
+        usage.size = size;
+        if (size == 0)
+            usage.mode = Mode::RangesOnly;
+    }
+
+    // Still waiting for another caller's lookup
+    if (usage.mode != Mode::Ranges || usage.size == 0)
+        return usage.mode == Mode::Whole;
+
+    double spent = static_cast<double>(usage.bytes + usage.ranges * requestOverhead_);
+    if (spent >= threshold_ * static_cast<double>(usage.size))
+        usage.mode = Mode::Whole;
+    return usage.mode == Mode::Whole;
+}
+
+void ArchivePrefetchPolicy::Failed(const std::string& archive) {
+    std::scoped_lock lock(mutex_);
+    usage_[archive].mode = Mode::RangesOnly;
+}
+
+uint64_t ArchivePrefetchPolicy::ArchiveSize(const std::string& archive) const {
+    std::scoped_lock lock(mutex_);
+    auto it = usage_.find(archive);
+    return it != usage_.end() ? it->second.size : 0;
+}
@@ -0,0 +1,52 @@
+#ifndef ARCHIVEPREFETCHPOLICY_H
+#define ARCHIVEPREFETCHPOLICY_H
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Decides when an archive is better downloaded whole than range by range. Every range costs its
+// bytes plus a fixed per-request overhead; once what was spent on an archive reaches threshold
+// times its size, the rest of the job is expected to follow and one full download is cheaper.
+class ArchivePrefetchPolicy {
+public:
+    // threshold of 0 disables whole-archive fetches
+    ArchivePrefetchPolicy(double threshold, size_t minRanges, uint64_t requestOverhead);
+
+    // Tells the size of an archive, 0 if it can't be found out
+    using SizeLookup = std::function<uint64_t(const std::string& archive)>;
+
+    // Count ranges about to be requested from archive. Returns true if the archive should be fetched
+    // whole instead, and keeps returning true for it from then on. archiveSize is only called once
+    // per archive, when it has had minRanges ranges.
+    bool Record(const std::string& archive, size_t ranges, uint64_t bytes, const SizeLookup& archiveSize);
+
+    // The whole download failed, stay with ranges for this archive
+    void Failed(const std::string& archive);
+
+    // Size looked up for archive, 0 if unknown
+    uint64_t ArchiveSize(const std::string& archive) const;
+
+private:
+    enum class Mode { Ranges, Whole, RangesOnly };
+
+    struct Usage {
+        size_t   ranges      = 0;
+        uint64_t bytes       = 0;
+        uint64_t size        = 0;
+        bool     sizeLookedUp = false;
+        Mode     mode        = Mode::Ranges;
+    };
+
+    double   threshold_;
+    size_t   minRanges_;
+    uint64_t requestOverhead_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Usage> usage_;
+};
+
+#endif //ARCHIVEPREFETCHPOLICY_H
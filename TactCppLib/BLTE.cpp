@@ -7,20 +7,86 @@
 // BLTE.cpp
 #include "BLTE.h"
 #include <stdexcept>
-#include <zlib.h>
 #include <cstring>
+#include <algorithm>
+#include <array>
+#include <execution>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <zlib.h>
 
 #include "utils/DataReader.h"
+#include "utils/Inflate.h"
 #include "utils/KeyService.h"
+#include "utils/MD5.h"
+#include "utils/Salsa20.h"
+
+namespace {
+    constexpr size_t blockInfoSize = 24;
+
+    // Per-thread pool of reusable buffers for decrypted chunks. Buffers are handed out as a stack,
+    // so chunks nested inside decrypted data get their own buffer.
+    struct ScratchBuffer {
+        std::vector<uint8_t> data;
+
+        ScratchBuffer() {
+            if (!pool().empty()) {
+                data = std::move(pool().back());
+                pool().pop_back();
+            }
+        }
+        ~ScratchBuffer() {
+            data.clear();
+            pool().push_back(std::move(data));
+        }
 
-// In BLTE.cpp, using DataReader:
+        static std::vector<std::vector<uint8_t>>& pool() {
+            thread_local std::vector<std::vector<uint8_t>> buffers;
+            return buffers;
+        }
+    };
+
+    // Deflate state reused by every chunk encoded on this thread
+    struct DeflateContext {
+        z_stream stream{};
+        int      level = -1;
 
-std::vector<uint8_t> BLTE::Decode(const std::vector<uint8_t>& data, uint64_t totalDecompSize) {
-    const size_t fixedHeaderSize = 8;
-    if (data.size() < fixedHeaderSize + 1)
+        ~DeflateContext() {
+            if (level != -1)
+                deflateEnd(&stream);
+        }
+
+        static z_stream& ForThread(int level) {
+            thread_local DeflateContext context;
+            if (context.level != level) {
+                if (context.level != -1)
+                    deflateEnd(&context.stream);
+                context.stream = {};
+                context.level = -1;
+                if (deflateInit(&context.stream, level) != Z_OK)
+                    throw std::runtime_error("Failed to init zlib deflate");
+                context.level = level;
+            } else if (deflateReset(&context.stream) != Z_OK) {
+                throw std::runtime_error("Failed to reset zlib deflate");
+            }
+            return context.stream;
+        }
+    };
+
+    void WriteUInt32BE(uint8_t* out, uint32_t value) {
+        out[0] = static_cast<uint8_t>(value >> 24);
+        out[1] = static_cast<uint8_t>(value >> 16);
+        out[2] = static_cast<uint8_t>(value >> 8);
+        out[3] = static_cast<uint8_t>(value);
+    }
+}
+
+uint32_t BLTE::ReadHeaderSize(const uint8_t* data, size_t size) {
+    if (size < FixedHeaderSize)
         throw std::runtime_error("Invalid BLTE header");
 
-    DataReader dr(const_cast<uint8_t*>(data.data()), data.size());
+    DataReader dr(const_cast<uint8_t*>(data), size);
 
     // 1) Magic check
     if (dr.ReadUInt8() != 'B' ||dr.ReadUInt8() != 'L' ||dr.ReadUInt8() != 'T' || dr.ReadUInt8() != 'E')
@@ -29,115 +95,457 @@ std::vector<uint8_t> BLTE::Decode(const std::vector<uint8_t>& data, uint64_t tot
     }
 
     // 2) headerSize (BE u32)
-    uint32_t headerSize = dr.ReadUInt32BE();
+    return dr.ReadUInt32BE();
+}
+
+BLTE::Header BLTE::ParseHeader(const uint8_t* data, size_t size) {
+    Header header;
+    header.headerSize = ReadHeaderSize(data, size);
+    if (header.headerSize == 0)
+        return header;
+
+    if (size < header.headerSize || header.headerSize < FixedHeaderSize + 4)
+        throw std::runtime_error("Data too small for declared headerSize");
 
-    // 3) Single-block
+    DataReader dr(const_cast<uint8_t*>(data), header.headerSize, FixedHeaderSize);
+
+    // tableFormat and chunkCount
+    char tableFormat = static_cast<char>(dr.ReadUInt8());
+    if (tableFormat != static_cast<char>(0xF))
+        throw std::runtime_error("Unexpected BLTE table format");
+
+    uint32_t chunkCount = dr.ReadUInt24BE();
+    if (FixedHeaderSize + 4 + size_t(chunkCount) * blockInfoSize > header.headerSize)
+        throw std::runtime_error("BLTE chunk table exceeds headerSize");
+
+    header.chunks.resize(chunkCount);
+
+    size_t infoOffset   = FixedHeaderSize + 4;
+    size_t compOffset   = header.headerSize;
+    size_t decompOffset = 0;
+
+    for (uint32_t chunkIndex = 0; chunkIndex < chunkCount; ++chunkIndex) {
+        dr.SetOffset(infoOffset);
+        uint32_t compSize   = dr.ReadUInt32BE();
+        uint32_t decompSize = dr.ReadUInt32BE();
+
+        if (compSize == 0)
+            throw std::runtime_error("Invalid size for BLTE chunk " + std::to_string(chunkIndex));
+
+        auto& chunk = header.chunks[chunkIndex];
+        chunk = {chunkIndex, compOffset, compSize, decompOffset, decompSize, {}};
+        std::memcpy(chunk.checksum.data(), data + dr.GetOffset(), chunk.checksum.size());
+
+        infoOffset   += blockInfoSize;
+        compOffset   += compSize;
+        decompOffset += decompSize;
+    }
+
+    header.decodedSize = decompOffset;
+    return header;
+}
+
+std::vector<uint8_t> BLTE::Encode(std::span<const uint8_t> data, const BLTEEncodeOptions& options) {
+    if (options.chunkSize == 0)
+        throw std::runtime_error("BLTE chunk size must not be 0");
+    if (options.compressionLevel < 0 || options.compressionLevel > 9)
+        throw std::runtime_error("Invalid BLTE compression level " + std::to_string(options.compressionLevel));
+
+    size_t chunkCount = (data.size() + options.chunkSize - 1) / options.chunkSize;
+    if (chunkCount > 0xFFFFFF)
+        throw std::runtime_error("Too many BLTE chunks, increase the chunk size");
+
+    // 1) encode and hash every chunk into its own buffer, mode byte included
+    std::vector<std::vector<uint8_t>> encoded(chunkCount);
+    std::vector<MD5::Digest> checksums(chunkCount);
+    auto encodeChunk = [&](std::vector<uint8_t>& out) {
+        size_t index  = &out - encoded.data();
+        size_t offset = index * options.chunkSize;
+        size_t size   = std::min<size_t>(options.chunkSize, data.size() - offset);
+        EncodeChunk(data.data() + offset, size, options.compressionLevel, out);
+        checksums[index] = MD5::Compute(out.data(), out.size());
+    };
+
+    if (options.parallelThreshold != 0 && chunkCount > 1 && data.size() >= options.parallelThreshold) {
+        std::mutex errorMutex;
+        std::exception_ptr error;
+        std::for_each(std::execution::par, encoded.begin(), encoded.end(), [&](std::vector<uint8_t>& out) {
+            try {
+                encodeChunk(out);
+            } catch (...) {
+                std::lock_guard lock(errorMutex);
+                if (!error)
+                    error = std::current_exception();
+            }
+        });
+        if (error)
+            std::rethrow_exception(error);
+    } else {
+        for (auto& out : encoded)
+            encodeChunk(out);
+    }
+
+    // 2) header and chunk table
+    size_t headerSize = FixedHeaderSize + 4 + chunkCount * blockInfoSize;
+    size_t totalSize  = headerSize;
+    for (const auto& chunk : encoded)
+        totalSize += chunk.size();
+
+    std::vector<uint8_t> result(totalSize);
+    uint8_t* out = result.data();
+
+    std::memcpy(out, "BLTE", 4);
+    WriteUInt32BE(out + 4, static_cast<uint32_t>(headerSize));
+    out[8]  = 0xF;
+    out[9]  = static_cast<uint8_t>(chunkCount >> 16);
+    out[10] = static_cast<uint8_t>(chunkCount >> 8);
+    out[11] = static_cast<uint8_t>(chunkCount);
+
+    // 3) chunk infos and payloads
+    uint8_t* info    = out + FixedHeaderSize + 4;
+    uint8_t* payload = out + headerSize;
+    for (size_t i = 0; i < chunkCount; ++i) {
+        const auto& chunk = encoded[i];
+        size_t decompSize = std::min<size_t>(options.chunkSize, data.size() - i * options.chunkSize);
+
+        WriteUInt32BE(info, static_cast<uint32_t>(chunk.size()));
+        WriteUInt32BE(info + 4, static_cast<uint32_t>(decompSize));
+        std::memcpy(info + 8, checksums[i].data(), checksums[i].size());
+        info += blockInfoSize;
+
+        std::memcpy(payload, chunk.data(), chunk.size());
+        payload += chunk.size();
+    }
+
+    return result;
+}
+
+void BLTE::EncodeChunk(const uint8_t* data, size_t size, int compressionLevel, std::vector<uint8_t>& out) {
+    if (compressionLevel > 0) {
+        z_stream& stream = DeflateContext::ForThread(compressionLevel);
+
+        out.resize(1 + deflateBound(&stream, static_cast<uLong>(size)));
+        out[0] = 'Z';
+
+        stream.next_in   = const_cast<Bytef*>(data);
+        stream.avail_in  = static_cast<uInt>(size);
+        stream.next_out  = out.data() + 1;
+        stream.avail_out = static_cast<uInt>(out.size() - 1);
+
+        if (deflate(&stream, Z_FINISH) != Z_STREAM_END)
+            throw std::runtime_error("Zlib compression error");
+
+        // Keep the compressed chunk only if it actually saves space
+        if (stream.total_out < size) {
+            out.resize(1 + stream.total_out);
+            return;
+        }
+    }
+
+    out.resize(1 + size);
+    out[0] = 'N';
+    std::memcpy(out.data() + 1, data, size);
+}
+
+uint64_t BLTE::GetDecodedSize(std::span<const uint8_t> data) {
+    uint32_t headerSize = ReadHeaderSize(data.data(), data.size());
+
+    // Single-block: only plain blocks carry their size implicitly
     if (headerSize == 0) {
-        dr.SetOffset(fixedHeaderSize);
-        char mode = static_cast<char>(dr.ReadUInt8());
+        if (data.size() < FixedHeaderSize + 1)
+            throw std::runtime_error("Invalid BLTE header");
+        return data[FixedHeaderSize] == 'N' ? data.size() - FixedHeaderSize - 1 : 0;
+    }
+
+    if (data.size() < headerSize || headerSize < FixedHeaderSize + 4)
+        throw std::runtime_error("Data too small for declared headerSize");
+
+    DataReader dr(const_cast<uint8_t*>(data.data()), headerSize, FixedHeaderSize + 1);
+    uint32_t chunkCount = dr.ReadUInt24BE();
+    if (FixedHeaderSize + 4 + size_t(chunkCount) * blockInfoSize > headerSize)
+        throw std::runtime_error("BLTE chunk table exceeds headerSize");
 
-        if (mode != 'N' && totalDecompSize == 0)
-            throw std::runtime_error(
-                "totalDecompSize must be set for single non-normal BLTE block"
-            );
-        if (mode == 'N' && totalDecompSize == 0)
-            totalDecompSize = data.size() - fixedHeaderSize - 1;
+    uint64_t decodedSize = 0;
+    for (uint32_t i = 0; i < chunkCount; ++i) {
+        dr.SetOffset(FixedHeaderSize + 4 + 4 + i * blockInfoSize);
+        decodedSize += dr.ReadUInt32BE();
+    }
+    return decodedSize;
+}
+
+size_t BLTE::Decode(std::span<const uint8_t> data, std::span<uint8_t> output, const BLTEDecodeOptions& options) {
+    if (data.size() < FixedHeaderSize + 1)
+        throw std::runtime_error("Invalid BLTE header");
 
-        std::vector<uint8_t> singleDecomp(static_cast<size_t>(totalDecompSize));
+    uint32_t headerSize = ReadHeaderSize(data.data(), data.size());
 
-        size_t compOffset = fixedHeaderSize + 1;
+    // 3) Single-block, the output span is the decoded size
+    if (headerSize == 0) {
+        char mode = static_cast<char>(data[FixedHeaderSize]);
+
+        size_t compOffset = FixedHeaderSize + 1;
         size_t compSize   = data.size() - compOffset;
 
-        HandleDataBlock( mode, data.data() + compOffset, compSize, 0, singleDecomp.data(), singleDecomp.size());
-        return singleDecomp;
+        HandleDataBlock( mode, data.data() + compOffset, compSize, 0, output.data(), output.size(), options);
+        return output.size();
     }
 
     // 4) Multi-chunk
-    if (data.size() < headerSize)
+    if (data.size() < headerSize || headerSize < FixedHeaderSize + 4)
         throw std::runtime_error("Data too small for declared headerSize");
 
-    // tableFormat and chunkCount
-    dr.SetOffset(fixedHeaderSize);
+    DataReader dr(const_cast<uint8_t*>(data.data()), headerSize, FixedHeaderSize);
+
     char tableFormat = static_cast<char>(dr.ReadUInt8());
     if (tableFormat != static_cast<char>(0xF))
         throw std::runtime_error("Unexpected BLTE table format");
 
     uint32_t chunkCount = dr.ReadUInt24BE();
 
-    constexpr size_t blockInfoSize = 24;
-    size_t infoStart = fixedHeaderSize + 4; // = 12
-
-    if (totalDecompSize == 0) {
-        for (uint32_t i = 0; i < chunkCount; ++i) {
-            dr.SetOffset(infoStart + 4 + i * blockInfoSize);
-            totalDecompSize += dr.ReadUInt32BE();
-        }
+    if (options.parallelThreshold != 0 && chunkCount > 1 && output.size() >= options.parallelThreshold) {
+        Header header = ParseHeader(data.data(), data.size());
+        ValidateChunks(header, data.size(), output.size());
+        DecodeChunks(data.data(), header.chunks, output.data(), true, options);
+        return static_cast<size_t>(header.decodedSize);
     }
 
-    std::vector<uint8_t> decompData(static_cast<size_t>(totalDecompSize));
+    // Serial path walks the chunk table in place, nothing is allocated
+    if (FixedHeaderSize + 4 + size_t(chunkCount) * blockInfoSize > headerSize)
+        throw std::runtime_error("BLTE chunk table exceeds headerSize");
 
-    size_t infoOffset   = infoStart;
     size_t compOffset   = headerSize;
     size_t decompOffset = 0;
 
     for (uint32_t chunkIndex = 0; chunkIndex < chunkCount; ++chunkIndex) {
-        dr.SetOffset(infoOffset);
+        dr.SetOffset(FixedHeaderSize + 4 + chunkIndex * blockInfoSize);
         uint32_t compSize   = dr.ReadUInt32BE();
         uint32_t decompSize = dr.ReadUInt32BE();
 
-        char mode = static_cast<char>(data[compOffset]);
+        if (compSize == 0 || compOffset + compSize > data.size())
+            throw std::runtime_error("BLTE chunk " + std::to_string(chunkIndex) + " exceeds data size");
+        if (decompOffset + decompSize > output.size())
+            throw std::runtime_error("BLTE chunk " + std::to_string(chunkIndex) + " exceeds output size");
+
+        if (options.verifyChecksums)
+            VerifyChunk(data.data() + compOffset, compSize, data.data() + dr.GetOffset(), chunkIndex);
 
+        char mode = static_cast<char>(data[compOffset]);
         HandleDataBlock( mode, data.data() + compOffset + 1, compSize - 1, static_cast<int>(chunkIndex),
-            decompData.data() + decompOffset, decompSize
+            output.data() + decompOffset, decompSize, options
         );
 
-        infoOffset   += blockInfoSize;
         compOffset   += compSize;
         decompOffset += decompSize;
     }
 
+    return decompOffset;
+}
+
+std::vector<uint8_t> BLTE::Decode(const std::vector<uint8_t>& data, uint64_t totalDecompSize,
+                                  const BLTEDecodeOptions& options) {
+    uint64_t decodedSize = GetDecodedSize(data);
+
+    if (decodedSize == 0 && totalDecompSize == 0 && data[FixedHeaderSize] != 'N' &&
+        ReadHeaderSize(data.data(), data.size()) == 0)
+        throw std::runtime_error(
+            "totalDecompSize must be set for single non-normal BLTE block"
+        );
+
+    if (totalDecompSize == 0)
+        totalDecompSize = decodedSize;
+    if (decodedSize > totalDecompSize)
+        throw std::runtime_error("BLTE chunks exceed decompressed size");
+
+    std::vector<uint8_t> decompData(static_cast<size_t>(totalDecompSize));
+    Decode(std::span<const uint8_t>(data), std::span<uint8_t>(decompData), options);
     return decompData;
 }
 
+void BLTE::ValidateChunks(const Header& header, size_t dataSize, size_t outputSize) {
+    if (header.chunks.empty())
+        return;
+
+    const auto& last = header.chunks.back();
+    if (last.compOffset + last.compSize > dataSize)
+        throw std::runtime_error("BLTE chunk " + std::to_string(last.index) + " exceeds data size");
+    if (header.decodedSize > outputSize)
+        throw std::runtime_error("BLTE chunks exceed output size");
+}
+
+std::pair<size_t, size_t> BLTE::GetEncodedRange(const Header& header, uint64_t offset, uint64_t length) {
+    if (header.headerSize == 0)
+        throw std::runtime_error("Single-block BLTE has no chunk table to locate ranges");
+    if (length == 0 || offset + length > header.decodedSize)
+        throw std::runtime_error("Requested range exceeds decoded BLTE size");
+
+    auto byDecompEnd = [](uint64_t value, const ChunkInfo& chunk) {
+        return value < chunk.decompOffset + chunk.decompSize;
+    };
+    // First chunks ending after the first and the last requested byte
+    auto first = std::upper_bound(header.chunks.begin(), header.chunks.end(), offset, byDecompEnd);
+    auto last  = std::upper_bound(first, header.chunks.end(), offset + length - 1, byDecompEnd);
+
+    return {first->compOffset, last->compOffset + last->compSize};
+}
+
+std::vector<uint8_t> BLTE::DecodeRange(const Header& header,
+                                       const uint8_t* encoded, size_t encodedSize, size_t encodedOffset,
+                                       uint64_t offset, uint64_t length,
+                                       const BLTEDecodeOptions& options) {
+    auto [rangeStart, rangeEnd] = GetEncodedRange(header, offset, length);
+    if (rangeStart < encodedOffset || rangeEnd > encodedOffset + encodedSize)
+        throw std::runtime_error("Encoded data does not cover the requested BLTE range");
+
+    std::vector<uint8_t> result(static_cast<size_t>(length));
+    std::vector<uint8_t> scratch;
+
+    for (const auto& chunk : header.chunks) {
+        uint64_t chunkEnd = chunk.decompOffset + chunk.decompSize;
+        if (chunkEnd <= offset || chunk.decompOffset >= offset + length)
+            continue;
+
+        const uint8_t* compData = encoded + (chunk.compOffset - encodedOffset);
+        if (options.verifyChecksums)
+            VerifyChunk(compData, chunk.compSize, chunk.checksum.data(), chunk.index);
+
+        char mode = static_cast<char>(compData[0]);
+
+        if (chunk.decompOffset >= offset && chunkEnd <= offset + length) {
+            // Fully covered chunks decode straight into the result
+            HandleDataBlock(mode, compData + 1, chunk.compSize - 1, static_cast<int>(chunk.index),
+                            result.data() + (chunk.decompOffset - offset), chunk.decompSize, options);
+            continue;
+        }
+
+        scratch.resize(chunk.decompSize);
+        HandleDataBlock(mode, compData + 1, chunk.compSize - 1, static_cast<int>(chunk.index),
+                        scratch.data(), chunk.decompSize, options);
+
+        uint64_t copyStart = std::max<uint64_t>(offset, chunk.decompOffset);
+        uint64_t copyEnd   = std::min<uint64_t>(offset + length, chunkEnd);
+        std::memcpy(result.data() + (copyStart - offset),
+                    scratch.data() + (copyStart - chunk.decompOffset),
+                    static_cast<size_t>(copyEnd - copyStart));
+    }
+
+    return result;
+}
+
+std::vector<uint8_t> BLTE::DecodeRange(const std::vector<uint8_t>& data, uint64_t offset, uint64_t length,
+                                       uint64_t totalDecompSize, const BLTEDecodeOptions& options) {
+    Header header = ParseHeader(data.data(), data.size());
+
+    // Single-block blobs have no chunk boundaries, so the whole block has to be decoded
+    if (header.headerSize == 0) {
+        auto decoded = Decode(data, totalDecompSize, options);
+        if (offset + length > decoded.size())
+            throw std::runtime_error("Requested range exceeds decoded BLTE size");
+        return {decoded.begin() + offset, decoded.begin() + offset + length};
+    }
+
+    return DecodeRange(header, data.data(), data.size(), 0, offset, length, options);
+}
+
+void BLTE::DecodeChunks(const uint8_t* data, const std::vector<ChunkInfo>& chunks,
+                        uint8_t* decompData, bool parallel, const BLTEDecodeOptions& options) {
+    auto decodeChunk = [&](const ChunkInfo& chunk) {
+        // Hashing happens in the same task as the decode, so it's spread over the pool too
+        if (options.verifyChecksums)
+            VerifyChunk(data + chunk.compOffset, chunk.compSize, chunk.checksum.data(), chunk.index);
+
+        char mode = static_cast<char>(data[chunk.compOffset]);
+
+        HandleDataBlock( mode, data + chunk.compOffset + 1, chunk.compSize - 1, static_cast<int>(chunk.index),
+            decompData + chunk.decompOffset, chunk.decompSize, options
+        );
+    };
+
+    if (!parallel) {
+        for (const auto& chunk : chunks)
+            decodeChunk(chunk);
+        return;
+    }
+
+    // Every chunk writes to its own slice of the output, so they can be inflated independently.
+    // Exceptions must not escape a parallel algorithm (std::terminate), keep the first one instead.
+    std::mutex errorMutex;
+    std::exception_ptr error;
+    std::for_each(std::execution::par, chunks.begin(), chunks.end(), [&](const ChunkInfo& chunk) {
+        try {
+            decodeChunk(chunk);
+        } catch (...) {
+            std::lock_guard lock(errorMutex);
+            if (!error)
+                error = std::current_exception();
+        }
+    });
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+void BLTE::VerifyChunk(const uint8_t* compData, size_t compSize, const uint8_t* checksum, uint32_t chunkIndex) {
+    auto digest = MD5::Compute(compData, compSize);
+    if (std::memcmp(digest.data(), checksum, digest.size()) != 0)
+        throw BLTEChecksumError(chunkIndex);
+}
+
 void BLTE::HandleDataBlock(char mode,
                            const uint8_t* compData, size_t compSize,
                            int chunkIndex,
-                           uint8_t* decompData, size_t decompSize) {
+                           uint8_t* decompData, size_t decompSize,
+                           const BLTEDecodeOptions& options) {
     switch (mode) {
         case 'N':
+            if (compSize < decompSize)
+                throw std::runtime_error("Plain BLTE chunk " + std::to_string(chunkIndex) + " is truncated");
             std::memcpy(decompData, compData, decompSize);
             break;
 
-        case 'Z': {
-            z_stream stream;
-            std::memset(&stream, 0, sizeof(stream));
-            stream.next_in   = const_cast<Bytef*>(compData);
-            stream.avail_in  = static_cast<uInt>(compSize);
-            stream.next_out  = decompData;
-            stream.avail_out = static_cast<uInt>(decompSize);
-            if (inflateInit(&stream) != Z_OK)
-                throw std::runtime_error("Failed to init zlib inflate");
-
-            int ret = inflate(&stream, Z_FINISH);
-            inflateEnd(&stream);
-            if (ret != Z_STREAM_END)
+        case 'Z':
+            if (!Inflate::Decompress(compData, compSize, decompData, decompSize))
                 throw std::runtime_error("Zlib decompression error");
             break;
-        }
 
-        case 'F':
-            throw std::runtime_error("Frame decompression not implemented");
+        case 'F': {
+            // Nested BLTE, decoded straight into this chunk's slice of the output with the outer
+            // options. Large frames go through the same parallel chunk decode as the outer blob.
+            size_t decoded = Decode(std::span<const uint8_t>(compData, compSize),
+                                    std::span<uint8_t>(decompData, decompSize), options);
+            if (decoded != decompSize)
+                throw std::runtime_error("BLTE frame " + std::to_string(chunkIndex) + " decoded to " +
+                                         std::to_string(decoded) + " bytes, expected " +
+                                         std::to_string(decompSize));
+            break;
+        }
 
         case 'E': {
-            std::vector<uint8_t> decrypted;
-            if (TryDecrypt(compData, compSize, chunkIndex, decrypted) && !decrypted.empty()) {
-                char nestedMode = static_cast<char>(decrypted[0]);
-                HandleDataBlock(nestedMode,
-                                decrypted.data() + 1,
-                                decrypted.size() - 1,
+            EncryptedBlock block;
+            if (!TryParseEncryptedBlock(compData, compSize, chunkIndex, block) || block.payloadSize == 0)
+                break; // unknown key, leave the output zeroed
+
+            const Salsa20& salsa = KeyService::SalsaInstance();
+
+            uint8_t nestedMode;
+            salsa.Decrypt(block.key, block.iv, block.payload, 1, &nestedMode);
+
+            if (nestedMode == 'N') {
+                // Plain payload: decrypt straight into the destination
+                if (block.payloadSize - 1 < decompSize)
+                    throw std::runtime_error("Encrypted BLTE chunk " + std::to_string(chunkIndex) + " is too small");
+                salsa.Decrypt(block.key, block.iv, block.payload + 1, decompSize, decompData, 1);
+            } else {
+                ScratchBuffer decrypted;
+                decrypted.data.resize(block.payloadSize - 1);
+                salsa.Decrypt(block.key, block.iv, block.payload + 1, decrypted.data.size(),
+                              decrypted.data.data(), 1);
+                HandleDataBlock(static_cast<char>(nestedMode),
+                                decrypted.data.data(),
+                                decrypted.data.size(),
                                 chunkIndex,
                                 decompData,
-                                decompSize);
+                                decompSize,
+                                options);
             }
             break;
         }
@@ -147,9 +555,9 @@ void BLTE::HandleDataBlock(char mode,
     }
 }
 
-bool BLTE::TryDecrypt(const uint8_t* data, size_t dataSize,
-                       int chunkIndex,
-                       std::vector<uint8_t>& output) {
+bool BLTE::TryParseEncryptedBlock(const uint8_t* data, size_t dataSize,
+                                  int chunkIndex,
+                                  EncryptedBlock& block) {
     DataReader dr(const_cast<uint8_t*>(data), dataSize);
 
     // 1) keyNameSize
@@ -161,8 +569,7 @@ bool BLTE::TryDecrypt(const uint8_t* data, size_t dataSize,
     uint64_t keyName = dr.ReadUInt64LE();
 
     // 3) lookup key
-    std::vector<uint8_t> key;
-    if (!KeyService::TryGetKey(keyName, key))
+    if (!KeyService::TryGetKey(keyName, block.key))
         return false;
 
     // 4) ivSize
@@ -170,35 +577,28 @@ bool BLTE::TryDecrypt(const uint8_t* data, size_t dataSize,
     if (ivSize != 4 || ivSize > 0x10)
         throw std::runtime_error("IVSize invalid");
 
-    // 5) IV bytes
-    std::vector<uint8_t> iv = dr.ReadUint8Array(ivSize);
-
-    // pad IV out to 8 bytes
-    iv.resize(8, 0);
+    // 5) IV bytes, padded out to 8 bytes
+    block.iv.fill(0);
+    std::memcpy(block.iv.data(), data + dr.GetOffset(), ivSize);
+    dr.SetOffset(dr.GetOffset() + ivSize);
 
     // 6) encryption type
     char encType = static_cast<char>(dr.ReadUInt8());
     if (encType != 'S' && encType != 'A')
         throw std::runtime_error(std::string("Unhandled encryption type: ") + encType);
 
+    if (encType == 'A') {
+        // ARC4 not implemented
+        throw std::runtime_error("Encryption type 'A' (ARC4) not implemented");
+    }
+
     // 7) XOR chunkIndex into first 4 bytes of IV
     for (int i = 0; i < 4; ++i) {
-        iv[i] ^= static_cast<uint8_t>((chunkIndex >> (i * 8)) & 0xFF);
+        block.iv[i] ^= static_cast<uint8_t>((chunkIndex >> (i * 8)) & 0xFF);
     }
 
-    // 8) decrypt payload
-    size_t dataOffset     = dr.GetOffset();
-    size_t encryptedSize  = dataSize - dataOffset;
-
-    if (encType == 'S') {
-        output.resize(encryptedSize);
-        // decrypt with Salsa
-        //TODO::!!!
-        // KeyService::SalsaInstance().Decrypt(key, iv, data + dataOffset, encryptedSize, output.data());
-        return true;
-    }
-    else {
-        // ARC4 not implemented
-        throw std::runtime_error("Encryption type 'A' (ARC4) not implemented");
-    }
+    // 8) remaining bytes are the Salsa20 payload
+    block.payload     = data + dr.GetOffset();
+    block.payloadSize = dataSize - dr.GetOffset();
+    return true;
 }
@@ -8,20 +8,125 @@
 #include <cstdint>
 #include <vector>
 #include <cstddef>
+#include <array>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+struct BLTEDecodeOptions {
+    // Multi-chunk blobs decoding to at least this many bytes have their chunks
+    // decoded in parallel. 0 keeps every blob on the serial path.
+    uint64_t parallelThreshold = 4 * 1024 * 1024;
+
+    // Check every chunk against the MD5 in the chunk table before decoding it.
+    // Single-block blobs carry no checksum and are never verified.
+    bool verifyChecksums = false;
+};
+
+struct BLTEEncodeOptions {
+    // Decoded bytes per chunk. Smaller chunks give finer random access, larger ones compress better.
+    uint32_t chunkSize = 256 * 1024;
+
+    // zlib level for 'Z' chunks, 0 stores every chunk as 'N'.
+    // Chunks that don't shrink are stored as 'N' regardless.
+    int compressionLevel = 6;
+
+    // Inputs of at least this many bytes have their chunks compressed in parallel. 0 keeps it serial.
+    uint64_t parallelThreshold = 4 * 1024 * 1024;
+};
+
+// Thrown when a chunk doesn't match its checksum, e.g. a corrupted cache file or a truncated download
+class BLTEChecksumError : public std::runtime_error {
+public:
+    explicit BLTEChecksumError(uint32_t chunkIndex)
+        : std::runtime_error("BLTE chunk " + std::to_string(chunkIndex) + " failed checksum verification"),
+          chunkIndex_(chunkIndex) {}
+
+    uint32_t ChunkIndex() const { return chunkIndex_; }
+
+private:
+    uint32_t chunkIndex_;
+};
 
 class BLTE {
 public:
+    struct ChunkInfo {
+        uint32_t index;
+        size_t   compOffset;    // from the start of the blob, includes the mode byte
+        uint32_t compSize;
+        size_t   decompOffset;
+        uint32_t decompSize;
+        std::array<uint8_t, 16> checksum;  // MD5 of the encoded chunk, mode byte included
+    };
+
+    struct Header {
+        uint32_t headerSize  = 0;  // 0 for single-block blobs, which have no chunk table
+        uint64_t decodedSize = 0;  // sum of the chunk decompressed sizes
+        std::vector<ChunkInfo> chunks;
+    };
+
+    static constexpr size_t FixedHeaderSize = 8;
+
     // Decode BLTE-encoded data. Throws on error.
-    static std::vector<uint8_t> Decode(const std::vector<uint8_t>& data, uint64_t totalDecompSize = 0);
+    static std::vector<uint8_t> Decode(const std::vector<uint8_t>& data, uint64_t totalDecompSize = 0,
+                                       const BLTEDecodeOptions& options = {});
+
+    // Decode straight into a caller-provided buffer, e.g. an mmapped file or a pooled buffer.
+    // output must hold GetDecodedSize() bytes (or the known size for single-block non-'N' blobs).
+    // Returns the number of bytes written.
+    static size_t Decode(std::span<const uint8_t> data, std::span<uint8_t> output,
+                         const BLTEDecodeOptions& options = {});
+
+    // Encode data as a multi-chunk BLTE blob with a checksummed chunk table, readable by
+    // Decode, DecodeRange and BLTEStreamDecoder.
+    static std::vector<uint8_t> Encode(std::span<const uint8_t> data, const BLTEEncodeOptions& options = {});
+
+    // Decoded size from the chunk table. 0 if it can't be known (single-block non-'N' blobs).
+    static uint64_t GetDecodedSize(std::span<const uint8_t> data);
+
+    // Header size declared by the first FixedHeaderSize bytes of a blob (0 for single-block)
+    static uint32_t ReadHeaderSize(const uint8_t* data, size_t size);
+
+    // Parse the chunk table. Only the first headerSize bytes of the blob are needed.
+    static Header ParseHeader(const uint8_t* data, size_t size);
+
+    // Encoded byte range [first, second) of the chunks covering decoded bytes [offset, offset + length)
+    static std::pair<size_t, size_t> GetEncodedRange(const Header& header, uint64_t offset, uint64_t length);
+
+    // Decode only the chunks covering decoded bytes [offset, offset + length).
+    // encoded holds the blob starting at encodedOffset, it only has to span GetEncodedRange().
+    static std::vector<uint8_t> DecodeRange(const Header& header,
+                                            const uint8_t* encoded, size_t encodedSize, size_t encodedOffset,
+                                            uint64_t offset, uint64_t length,
+                                            const BLTEDecodeOptions& options = {});
+    static std::vector<uint8_t> DecodeRange(const std::vector<uint8_t>& data, uint64_t offset, uint64_t length,
+                                            uint64_t totalDecompSize = 0, const BLTEDecodeOptions& options = {});
 
 private:
+    friend class BLTEStreamDecoder;
+
+    static void ValidateChunks(const Header& header, size_t dataSize, size_t outputSize);
+    static void DecodeChunks(const uint8_t* data, const std::vector<ChunkInfo>& chunks,
+                             uint8_t* decompData, bool parallel, const BLTEDecodeOptions& options);
+    static void EncodeChunk(const uint8_t* data, size_t size, int compressionLevel, std::vector<uint8_t>& out);
+    static void VerifyChunk(const uint8_t* compData, size_t compSize, const uint8_t* checksum, uint32_t chunkIndex);
     static void HandleDataBlock(char mode,
                                 const uint8_t* compData, size_t compSize,
                                 int chunkIndex,
-                                uint8_t* decompData, size_t decompSize);
-    static bool TryDecrypt(const uint8_t* data, size_t dataSize,
-                           int chunkIndex,
-                           std::vector<uint8_t>& output);
+                                uint8_t* decompData, size_t decompSize,
+                                const BLTEDecodeOptions& options = {});
+    struct EncryptedBlock {
+        std::span<const uint8_t> key;
+        std::array<uint8_t, 8>   iv{};
+        const uint8_t*           payload = nullptr;
+        size_t                   payloadSize = 0;
+    };
+
+    // Parses the 'E' chunk header. Returns false if the key is unknown.
+    static bool TryParseEncryptedBlock(const uint8_t* data, size_t dataSize,
+                                       int chunkIndex,
+                                       EncryptedBlock& block);
 };
 
 #endif //BLTE_H
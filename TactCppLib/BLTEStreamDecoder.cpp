@@ -0,0 +1,261 @@
+#include "BLTEStreamDecoder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <zlib.h>
+
+#include "BLTE.h"
+#include "utils/DataReader.h"
+
+namespace {
+    constexpr size_t fixedHeaderSize = 8;
+    constexpr size_t blockInfoSize   = 24;
+    constexpr size_t inflateBufferSize = 64 * 1024;
+}
+
+struct BLTEStreamDecoder::Inflater {
+    z_stream stream{};
+    bool     finished = false;
+
+    Inflater() {
+        if (inflateInit(&stream) != Z_OK)
+            throw std::runtime_error("Failed to init zlib inflate");
+    }
+    ~Inflater() {
+        inflateEnd(&stream);
+    }
+};
+
+BLTEStreamDecoder::BLTEStreamDecoder(Sink sink, uint64_t totalDecompSize, bool verifyChecksums)
+    : sink_(std::move(sink)), totalDecompSize_(totalDecompSize), verifyChecksums_(verifyChecksums) {
+    frameOptions_.verifyChecksums = verifyChecksums;
+    pending_.reserve(fixedHeaderSize);
+}
+
+BLTEStreamDecoder::~BLTEStreamDecoder() = default;
+
+void BLTEStreamDecoder::Feed(const uint8_t* data, size_t size) {
+    while (size > 0) {
+        size_t consumed = 0;
+
+        switch (state_) {
+            case State::Header: {
+                consumed = std::min(size, fixedHeaderSize - pending_.size());
+                pending_.insert(pending_.end(), data, data + consumed);
+                if (pending_.size() < fixedHeaderSize)
+                    break;
+
+                if (std::memcmp(pending_.data(), "BLTE", 4) != 0)
+                    throw std::runtime_error("Invalid BLTE header");
+
+                DataReader dr(pending_.data(), pending_.size(), 4);
+                headerSize_ = dr.ReadUInt32BE();
+                if (headerSize_ == 0) {
+                    pending_.clear();
+                    state_ = State::SingleMode;
+                } else {
+                    if (headerSize_ < fixedHeaderSize + 4)
+                        throw std::runtime_error("Invalid BLTE header size");
+                    state_ = State::ChunkTable;
+                }
+                break;
+            }
+
+            case State::ChunkTable:
+                consumed = std::min<size_t>(size, headerSize_ - pending_.size());
+                pending_.insert(pending_.end(), data, data + consumed);
+                if (pending_.size() == headerSize_)
+                    ParseChunkTable();
+                break;
+
+            case State::ChunkMode:
+            case State::Chunk:
+                consumed = ConsumeChunk(data, size);
+                break;
+
+            case State::SingleMode:
+            case State::SingleBlock:
+                consumed = ConsumeSingleBlock(data, size);
+                break;
+
+            case State::Done:
+                throw std::runtime_error("Unexpected data after end of BLTE stream");
+        }
+
+        data += consumed;
+        size -= consumed;
+    }
+}
+
+void BLTEStreamDecoder::Finish() {
+    if (state_ == State::SingleBlock) {
+        if (chunkMode_ == 'Z') {
+            if (!inflater_->finished)
+                throw std::runtime_error("Truncated BLTE stream");
+        } else if (chunkMode_ != 'N') {
+            if (totalDecompSize_ == 0)
+                throw std::runtime_error("totalDecompSize must be set for single non-normal BLTE block");
+
+            decompBuffer_.resize(static_cast<size_t>(totalDecompSize_));
+            BLTE::HandleDataBlock(chunkMode_, pending_.data(), pending_.size(), 0,
+                                  decompBuffer_.data(), decompBuffer_.size(), frameOptions_);
+            Emit(decompBuffer_.data(), decompBuffer_.size());
+        }
+        state_ = State::Done;
+    }
+
+    if (state_ != State::Done)
+        throw std::runtime_error("Truncated BLTE stream");
+    if (totalDecompSize_ != 0 && decodedSize_ != totalDecompSize_)
+        throw std::runtime_error("BLTE stream decoded to " + std::to_string(decodedSize_) +
+                                 " bytes, expected " + std::to_string(totalDecompSize_));
+}
+
+void BLTEStreamDecoder::ParseChunkTable() {
+    DataReader dr(pending_.data(), pending_.size(), fixedHeaderSize);
+
+    if (dr.ReadUInt8() != 0xF)
+        throw std::runtime_error("Unexpected BLTE table format");
+
+    uint32_t chunkCount = dr.ReadUInt24BE();
+    if (fixedHeaderSize + 4 + size_t(chunkCount) * blockInfoSize > headerSize_)
+        throw std::runtime_error("BLTE chunk table exceeds header size");
+
+    chunks_.resize(chunkCount);
+    for (auto& chunk : chunks_) {
+        chunk.compSize   = dr.ReadUInt32BE();
+        chunk.decompSize = dr.ReadUInt32BE();
+        std::memcpy(chunk.checksum.data(), pending_.data() + dr.GetOffset(), chunk.checksum.size());
+        dr.SetOffset(dr.GetOffset() + 16);
+
+        if (chunk.compSize == 0)
+            throw std::runtime_error("Invalid BLTE chunk size");
+    }
+
+    pending_.clear();
+    state_ = chunks_.empty() ? State::Done : State::ChunkMode;
+}
+
+size_t BLTEStreamDecoder::ConsumeChunk(const uint8_t* data, size_t size) {
+    const Chunk& chunk = chunks_[chunkIndex_];
+    size_t consumed = 0;
+
+    if (state_ == State::ChunkMode) {
+        chunkMode_ = static_cast<char>(data[0]);
+        if (chunkMode_ == 'N' && chunk.compSize - 1 != chunk.decompSize)
+            throw std::runtime_error("BLTE chunk " + std::to_string(chunkIndex_) + " has mismatched sizes");
+
+        if (verifyChecksums_) {
+            chunkHash_ = MD5();
+            chunkHash_.Update(data, 1);
+        }
+
+        chunkConsumed_ = 1;
+        consumed = 1;
+        state_ = State::Chunk;
+    }
+
+    size_t remaining = chunk.compSize - chunkConsumed_;
+    size_t take = std::min(size - consumed, remaining);
+    const uint8_t* payload = data + consumed;
+
+    // Checked before the chunk is decoded, so corruption isn't reported as a decode error
+    if (verifyChecksums_) {
+        chunkHash_.Update(payload, take);
+        if (take == remaining)
+            VerifyChunk();
+    }
+
+    if (chunkMode_ == 'N') {
+        // Plain chunks pass straight through without buffering
+        Emit(payload, take);
+    } else if (pending_.empty() && take == remaining) {
+        // Whole chunk is available in the caller's buffer, decode without copying it
+        decompBuffer_.resize(chunk.decompSize);
+        BLTE::HandleDataBlock(chunkMode_, payload, take, static_cast<int>(chunkIndex_),
+                              decompBuffer_.data(), chunk.decompSize, frameOptions_);
+        Emit(decompBuffer_.data(), chunk.decompSize);
+    } else {
+        pending_.insert(pending_.end(), payload, payload + take);
+        if (pending_.size() == chunk.compSize - 1) {
+            decompBuffer_.resize(chunk.decompSize);
+            BLTE::HandleDataBlock(chunkMode_, pending_.data(), pending_.size(), static_cast<int>(chunkIndex_),
+                                  decompBuffer_.data(), chunk.decompSize, frameOptions_);
+            Emit(decompBuffer_.data(), chunk.decompSize);
+            pending_.clear();
+        }
+    }
+
+    chunkConsumed_ += static_cast<uint32_t>(take);
+    consumed += take;
+
+    if (chunkConsumed_ == chunk.compSize) {
+        chunkConsumed_ = 0;
+        if (++chunkIndex_ == chunks_.size())
+            state_ = State::Done;
+        else
+            state_ = State::ChunkMode;
+    }
+
+    return consumed;
+}
+
+void BLTEStreamDecoder::VerifyChunk() const {
+    auto digest = MD5(chunkHash_).Final();
+    if (digest != chunks_[chunkIndex_].checksum)
+        throw BLTEChecksumError(chunkIndex_);
+}
+
+size_t BLTEStreamDecoder::ConsumeSingleBlock(const uint8_t* data, size_t size) {
+    size_t consumed = 0;
+
+    if (state_ == State::SingleMode) {
+        chunkMode_ = static_cast<char>(data[0]);
+        if (chunkMode_ == 'Z') {
+            inflater_ = std::make_unique<Inflater>();
+            decompBuffer_.resize(inflateBufferSize);
+        }
+        consumed = 1;
+        state_ = State::SingleBlock;
+    }
+
+    const uint8_t* payload = data + consumed;
+    size_t payloadSize = size - consumed;
+
+    if (chunkMode_ == 'N') {
+        Emit(payload, payloadSize);
+    } else if (chunkMode_ == 'Z') {
+        auto& stream = inflater_->stream;
+        stream.next_in  = const_cast<Bytef*>(payload);
+        stream.avail_in = static_cast<uInt>(payloadSize);
+
+        do {
+            stream.next_out  = decompBuffer_.data();
+            stream.avail_out = static_cast<uInt>(decompBuffer_.size());
+
+            int ret = inflate(&stream, Z_NO_FLUSH);
+            if (ret == Z_BUF_ERROR)
+                break; // needs more input
+            if (ret != Z_OK && ret != Z_STREAM_END)
+                throw std::runtime_error("Zlib decompression error");
+
+            Emit(decompBuffer_.data(), decompBuffer_.size() - stream.avail_out);
+            inflater_->finished = (ret == Z_STREAM_END);
+        } while (!inflater_->finished && (stream.avail_in > 0 || stream.avail_out == 0));
+    } else {
+        // Encrypted/framed single blocks need the whole payload before they can be decoded
+        pending_.insert(pending_.end(), payload, payload + payloadSize);
+    }
+
+    return size;
+}
+
+void BLTEStreamDecoder::Emit(const uint8_t* data, size_t size) {
+    if (size == 0)
+        return;
+
+    decodedSize_ += size;
+    sink_(data, size);
+}
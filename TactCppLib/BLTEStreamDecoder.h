@@ -0,0 +1,74 @@
+#ifndef BLTESTREAMDECODER_H
+#define BLTESTREAMDECODER_H
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "BLTE.h"
+#include "utils/MD5.h"
+
+// Incremental BLTE decoder: encoded bytes are fed as they arrive and decoded
+// bytes are handed to the sink chunk by chunk, so memory stays bounded by the
+// largest chunk instead of the whole file.
+class BLTEStreamDecoder {
+public:
+    using Sink = std::function<void(const uint8_t* data, size_t size)>;
+
+    // totalDecompSize is only required for single-block non-'N' blobs (same as BLTE::Decode).
+    // verifyChecksums hashes every chunk as it arrives and throws BLTEChecksumError on mismatch,
+    // plain chunks may already have been handed to the sink by then.
+    explicit BLTEStreamDecoder(Sink sink, uint64_t totalDecompSize = 0, bool verifyChecksums = false);
+    ~BLTEStreamDecoder();
+
+    BLTEStreamDecoder(const BLTEStreamDecoder&) = delete;
+    BLTEStreamDecoder& operator=(const BLTEStreamDecoder&) = delete;
+
+    // Consume the next piece of encoded data. Throws on malformed input.
+    void Feed(const uint8_t* data, size_t size);
+
+    // Signal end of input. Throws if the blob was truncated.
+    void Finish();
+
+    uint64_t DecodedSize() const { return decodedSize_; }
+
+private:
+    enum class State { Header, ChunkTable, ChunkMode, Chunk, SingleMode, SingleBlock, Done };
+
+    struct Chunk {
+        uint32_t compSize;
+        uint32_t decompSize;
+        std::array<uint8_t, 16> checksum;
+    };
+
+    size_t ConsumeChunk(const uint8_t* data, size_t size);
+    size_t ConsumeSingleBlock(const uint8_t* data, size_t size);
+    void   ParseChunkTable();
+    void   VerifyChunk() const;
+    void   Emit(const uint8_t* data, size_t size);
+
+    Sink                 sink_;
+    uint64_t             totalDecompSize_;
+    bool                 verifyChecksums_;
+    BLTEDecodeOptions    frameOptions_;  // passed down to nested 'F' frames
+    uint64_t             decodedSize_ = 0;
+    State                state_ = State::Header;
+
+    uint32_t             headerSize_ = 0;
+    std::vector<uint8_t> pending_;       // header bytes or the compressed bytes of the current chunk
+    std::vector<uint8_t> decompBuffer_;  // reused output buffer, sized to the largest chunk seen
+
+    std::vector<Chunk>   chunks_;
+    uint32_t             chunkIndex_ = 0;
+    char                 chunkMode_ = 0;
+    uint32_t             chunkConsumed_ = 0;
+    MD5                  chunkHash_;
+
+    struct Inflater;
+    std::unique_ptr<Inflater> inflater_;  // single-block 'Z' streams are inflated incrementally
+};
+
+#endif //BLTESTREAMDECODER_H
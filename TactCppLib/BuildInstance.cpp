@@ -15,7 +15,7 @@ namespace fs = std::filesystem;
 BuildInstance::BuildInstance()
 {
     settings_ = std::make_shared<Settings>();
-    cdn_ = std::make_shared<CDN>(*settings_);
+    cdn_ = std::make_shared<CDN>(settings_);
 }
 
 void BuildInstance::LoadConfigs(const std::string& buildConfigPath,
@@ -24,6 +24,9 @@ void BuildInstance::LoadConfigs(const std::string& buildConfigPath,
     settings_->BuildConfig = buildConfigPath;
     settings_->CDNConfig = cdnConfigPath;
 
+    // Nothing else can start before the configs are in, they go ahead of queued file downloads
+    DownloadScheduler::PriorityScope metadata(DownloadPriority::Metadata);
+
     auto start = std::chrono::steady_clock::now();
 
     // BuildConfig
@@ -59,8 +62,11 @@ void BuildInstance::Load()
     if (!buildConfig_ || !cdnConfig_)
         throw std::runtime_error("Configs not loaded");
 
+    // Indices, encoding, root and install go ahead of queued file downloads
+    DownloadScheduler::PriorityScope metadata(DownloadPriority::Metadata);
+
     // if a local base dir is set, switch CDN to local
-    if (!settings_->BaseDir.has_value())
+    if (settings_->BaseDir.has_value())
         cdn_->OpenLocal();
 
     // --- Group index ---
@@ -264,3 +270,88 @@ std::vector<uint8_t> BuildInstance::OpenFileByEKey(const std::vector<uint8_t>& e
 
     return data;
 }
+
+std::vector<uint8_t> BuildInstance::OpenFileRangeByEKey(const std::vector<uint8_t>& eKey,
+                                                        uint64_t offset,
+                                                        uint64_t length,
+                                                        uint64_t decodedSize)
+{
+    if (!groupIndex_ || !fileIndex_)
+        throw std::runtime_error("Indexes not loaded");
+
+    auto [archiveOffset, size, archiveIdx] = groupIndex_->GetIndexInfo(eKey);
+
+    if (archiveOffset == -1) {
+        // Loose files are fetched whole, only the untouched chunks are skipped while decoding
+        auto [fileOffset, fileSize, arcIdx] = fileIndex_->GetIndexInfo(eKey);
+        auto data = cdn_->GetFile("data",
+                                  bytesToHexLower(eKey),
+                                  fileSize == -1 ? 0 : fileSize,
+                                  decodedSize,
+                                  false);
+        BLTEDecodeOptions options;
+        options.verifyChecksums = settings_->VerifyChecksums;
+        return BLTE::DecodeRange(data, offset, length, decodedSize, options);
+    }
+
+    return cdn_->GetFileRangeFromArchive(bytesToHexLower(eKey),
+                                         cdnConfig_->Values.at("archives")[archiveIdx],
+                                         archiveOffset,
+                                         size,
+                                         offset,
+                                         length,
+                                         decodedSize);
+}
+
+void BuildInstance::PrefetchFilesByEKey(const std::vector<std::vector<uint8_t>>& eKeys)
+{
+    if (!groupIndex_ || !fileIndex_)
+        throw std::runtime_error("Indexes not loaded");
+
+    // Loose files are one request each anyway, only archived ones can share requests
+    std::vector<CDN::ArchiveRange> ranges;
+    for (const auto& eKey : eKeys) {
+        auto [offset, size, archiveIdx] = groupIndex_->GetIndexInfo(eKey);
+        if (offset == -1)
+            continue;
+
+        ranges.push_back({bytesToHexLower(eKey),
+                          cdnConfig_->Values.at("archives")[archiveIdx],
+                          static_cast<size_t>(offset),
+                          static_cast<size_t>(size)});
+    }
+
+    if (!ranges.empty())
+        cdn_->PrefetchFilesFromArchives(ranges);
+}
+
+void BuildInstance::StreamFileByEKey(const std::vector<uint8_t>& eKey,
+                                     const CDN::DataSink& sink,
+                                     uint64_t decodedSize)
+{
+    if (!groupIndex_ || !fileIndex_)
+        throw std::runtime_error("Indexes not loaded");
+
+    auto [offset, size, archiveIdx] = groupIndex_->GetIndexInfo(eKey);
+
+    if (offset == -1) {
+        auto [fileOffset, fileSize, arcIdx] = fileIndex_->GetIndexInfo(eKey);
+        if (fileSize == -1) {
+            std::cout << "Warning: EKey " << bytesToHexLower(eKey)
+                      << " not found in group or file index and might not be available on CDN.\n";
+        }
+        cdn_->StreamDecodedFile("data",
+                                bytesToHexLower(eKey),
+                                sink,
+                                fileSize == -1 ? 0 : fileSize,
+                                decodedSize);
+    }
+    else {
+        cdn_->StreamDecodedFileFromArchive(bytesToHexLower(eKey),
+                                           cdnConfig_->Values.at("archives")[archiveIdx],
+                                           offset,
+                                           size,
+                                           sink,
+                                           decodedSize);
+    }
+}
@@ -37,6 +37,20 @@ public:
     std::vector<uint8_t> OpenFileByEKey(const std::vector<uint8_t>& eKey,
                                         uint64_t decodedSize = 0);
 
+    // decode only bytes [offset, offset + length) of the file
+    std::vector<uint8_t> OpenFileRangeByEKey(const std::vector<uint8_t>& eKey,
+                                             uint64_t offset,
+                                             uint64_t length,
+                                             uint64_t decodedSize = 0);
+
+    // decode into sink while downloading, peak memory is one BLTE chunk
+    void StreamFileByEKey(const std::vector<uint8_t>& eKey,
+                          const CDN::DataSink& sink,
+                          uint64_t decodedSize = 0);
+
+    // download every archived file of eKeys with as few range requests as possible, filling the CDN cache
+    void PrefetchFilesByEKey(const std::vector<std::vector<uint8_t>>& eKeys);
+
     // getters
     std::shared_ptr<Config>             GetBuildConfig() const { return buildConfig_; }
     std::shared_ptr<Config>             GetCDNConfig()   const { return cdnConfig_;   }
@@ -1,5 +1,9 @@
+#ifndef CASCINDEXINSTANCE_H
+#define CASCINDEXINSTANCE_H
+
 #include <windows.h>
 #include <string>
+#include <memory>
 #include <stdexcept>
 #include <tuple>
 #include <span>
@@ -50,21 +54,30 @@ public:
         fileData = static_cast<uint8_t *>(file->data());
 
         indexSize = file->size();
+        if (indexSize < sizeof(IndexHeader))
+            throw std::runtime_error("Truncated CASC index: " + path);
 
         // Read header
         header = *reinterpret_cast<IndexHeader*>(file->data());
 
+        // Entries are decoded as a 1+4 byte archive index/offset and a 4 byte size
+        if (header.entryOffsetBytes != 5 || header.entrySizeBytes != 4)
+            throw std::runtime_error("Unsupported CASC index entry layout: " + path);
+
         // Compute entry layout
         entrySize = static_cast<size_t>(header.entrySizeBytes +
                                         header.entryOffsetBytes +
                                         header.entryKeyBytes);
         ofsStartOfEntries = sizeof(IndexHeader);
         ofsEndOfEntries = ofsStartOfEntries + header.entriesSize;
+        if (ofsEndOfEntries > indexSize)
+            throw std::runtime_error("Truncated CASC index: " + path);
     }
 
     ~CASCIndexInstance() {
     }
 
+    // Offset and size of the entry's record in data.<archiveIndex>, including its 0x1E byte header
     struct FileArchiveData {int archiveOffset; int archiveSize; int archiveIndex;};
 
     // Returns tuple(offset, size, archiveIndex), or (-1,-1,-1) if not found
@@ -84,31 +97,45 @@ public:
 
         // Use std::lower_bound to find the first entry >= key
         auto it = std::lower_bound(beginIt, endIt, key, cmp);
-        const uint8_t* found = (it != endIt) ? *it : (fileData + ofsStartOfEntries);
-
-        if (found == fileData + ofsStartOfEntries)
+        if (it == endIt)
             return {-1, -1, -1};
 
-        size_t idx = (found - (fileData + ofsStartOfEntries)) / entrySize;
-        uint8_t* entryPtr = fileData + ofsStartOfEntries + idx * entrySize;
+        const uint8_t* entryPtr = *it;
 
         // Verify exact match of key prefix
         if (std::memcmp(entryPtr, key, header.entryKeyBytes) != 0)
             return {-1, -1, -1};
 
+        return DecodeEntry(entryPtr);
+    }
+
+    size_t KeyBytes() const { return header.entryKeyBytes; }
+    size_t EntryCount() const { return entrySize ? header.entriesSize / entrySize : 0; }
+
+    // Calls fn(key, info) for every entry, in key order
+    template<typename Fn>
+    void ForEachEntry(Fn&& fn) const {
+        for (size_t ofs = ofsStartOfEntries; ofs + entrySize <= ofsEndOfEntries; ofs += entrySize) {
+            const uint8_t* entryPtr = fileData + ofs;
+            fn(std::span<const uint8_t>(entryPtr, header.entryKeyBytes), DecodeEntry(entryPtr));
+        }
+    }
+
+private:
+    FileArchiveData DecodeEntry(const uint8_t* entryPtr) const {
         // Read archiveIndex and offsets
-        DataReader dr(entryPtr +header.entryKeyBytes, entrySize);
+        DataReader dr(const_cast<uint8_t*>(entryPtr) + header.entryKeyBytes, entrySize);
 
         uint8_t indexHigh = dr.ReadUInt8();
         uint32_t indexLow = dr.ReadInt32BE();
 
         uint32_t rawSize  = dr.ReadInt32LE();
 
-        int dataSize = int(rawSize) - 30;
-
         int archiveIdx = (int(indexHigh) << 2) | int((indexLow & 0xC0000000) >> 30);
-        int archiveOff = int(indexLow & 0x3FFFFFFF) + 30;
+        int archiveOff = int(indexLow & 0x3FFFFFFF);
 
-        return {archiveOff, dataSize, archiveIdx};
+        return {archiveOff, int(rawSize), archiveIdx};
     }
 };
+
+#endif //CASCINDEXINSTANCE_H
@@ -0,0 +1,53 @@
+#include "CASCMergedIndex.h"
+
+#include <algorithm>
+#include <execution>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+CASCMergedIndex::CASCMergedIndex(const std::vector<const CASCIndexInstance*>& buckets) {
+    for (const auto* bucket : buckets) {
+        if (bucket->KeyBytes() != KeyBytes)
+            throw std::runtime_error("CASC index with " + std::to_string(bucket->KeyBytes()) + " byte keys can't be merged");
+    }
+
+    // 1) Every bucket gets its own slice of the table, filled in parallel
+    std::vector<size_t> starts(buckets.size() + 1, 0);
+    for (size_t i = 0; i < buckets.size(); ++i)
+        starts[i + 1] = starts[i] + buckets[i]->EntryCount();
+    entries_.resize(starts.back());
+
+    std::vector<size_t> order(buckets.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::for_each(std::execution::par, order.begin(), order.end(), [&](size_t i) {
+        Entry* out = entries_.data() + starts[i];
+        buckets[i]->ForEachEntry([&](std::span<const uint8_t> key, const CASCIndexInstance::FileArchiveData& info) {
+            std::copy_n(key.begin(), KeyBytes, out->key.begin());
+            out->archiveIndex  = static_cast<uint16_t>(info.archiveIndex);
+            out->archiveOffset = info.archiveOffset;
+            out->archiveSize   = info.archiveSize;
+            ++out;
+        });
+    });
+
+    // 2) Buckets split the key space by hash, so their sorted runs interleave. Stable keeps the
+    //    first of duplicate keys first, like the lookup within a bucket.
+    std::stable_sort(std::execution::par, entries_.begin(), entries_.end(),
+        [](const Entry& a, const Entry& b) { return a.key < b.key; });
+}
+
+CASCIndexInstance::FileArchiveData CASCMergedIndex::GetIndexInfo(std::span<const uint8_t> eKeyTarget) const {
+    if (eKeyTarget.size() < KeyBytes)
+        return {-1, -1, -1};
+
+    std::array<uint8_t, KeyBytes> key;
+    std::copy_n(eKeyTarget.begin(), KeyBytes, key.begin());
+
+    auto it = std::lower_bound(entries_.begin(), entries_.end(), key,
+        [](const Entry& entry, const std::array<uint8_t, KeyBytes>& k) { return entry.key < k; });
+    if (it == entries_.end() || it->key != key)
+        return {-1, -1, -1};
+
+    return {it->archiveOffset, it->archiveSize, it->archiveIndex};
+}
@@ -0,0 +1,38 @@
+#ifndef CASCMERGEDINDEX_H
+#define CASCMERGEDINDEX_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "CASCIndexInstance.h"
+
+// The entries of all bucket .idx files of a local install copied into one sorted table, so a
+// lookup is a single binary search over 20 byte entries instead of a bucket pick and a search
+// through a mapped file.
+class CASCMergedIndex {
+public:
+    static constexpr size_t KeyBytes = 9;
+
+    // Throws if a bucket uses another key length
+    explicit CASCMergedIndex(const std::vector<const CASCIndexInstance*>& buckets);
+
+    // Same result as CASCIndexInstance::GetIndexInfo of the key's bucket
+    CASCIndexInstance::FileArchiveData GetIndexInfo(std::span<const uint8_t> eKeyTarget) const;
+
+    size_t size() const { return entries_.size(); }
+
+private:
+    struct Entry {
+        std::array<uint8_t, KeyBytes> key;
+        uint16_t archiveIndex;
+        int32_t  archiveOffset;
+        int32_t  archiveSize;
+    };
+
+    std::vector<Entry> entries_;
+};
+
+#endif //CASCMERGEDINDEX_H
@@ -7,6 +7,11 @@
 #include <chrono>
 #include <ranges>
 #include <format>
+#include <cstdlib>
+#include <condition_variable>
+#include <exception>
+#include <charconv>
+#include <map>
 
 #ifndef __ANDROID__
 #include "cpr/cpr.h"
@@ -34,15 +39,79 @@ inline std::vector<uint8_t> readFile(const std::string& path) {
     return buffer;
 }
 
+// Writes next to path and renames into place, so a crash never leaves a truncated file behind
+static void writeFileAtomic(const std::filesystem::path& path, const std::vector<uint8_t>& data) {
+    auto partPath = path;
+    partPath += ".part";
 
+    {
+        std::ofstream out(partPath, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(data.data()), data.size());
+        if (!out)
+            throw std::runtime_error("Error writing file: " + partPath.string());
+    }
+    std::filesystem::rename(partPath, path);
+}
+
+
+
+
+CDN::~CDN() {
+    // Cancelled hedge racers still reference this instance
+    std::scoped_lock lock(hedgeLosersMutex_);
+    for (auto& racer : hedgeLosers_)
+        racer.wait();
+}
+
+CDN::CDN(std::shared_ptr<Settings> settings)
+    : settings_(std::move(settings)) {
+    if (settings_->MirrorDir.has_value())
+        SetMirror(settings_->MirrorDir.value());
+}
 
+void CDN::CreateComponents() {
+    std::call_once(componentsOnce_, [this] {
+        const Settings &settings = *settings_;
+        httpSessions_ = std::make_unique<HttpSessionPool>(settings.MaxIdleConnectionsPerServer);
+        cache_ = std::make_unique<CacheManager>(settings.CacheDir, settings.MaxCacheSize, [this](const std::filesystem::path& path) {
+            // Anything being downloaded or read holds its file lock. Recursive, as the evicting thread may
+            // itself hold the stripe of the file it just added.
+            std::unique_lock lock(FileLock(path), std::try_to_lock);
+            if (!lock)
+                return false;
+            std::error_code ec;
+            std::filesystem::remove(path, ec);
+            return !ec;
+        });
+        hotObjects_ = std::make_unique<HotObjectCache>(settings.HotObjectCacheSize);
+        archivePolicy_ = std::make_unique<ArchivePrefetchPolicy>(settings.WholeArchiveThreshold, settings.WholeArchiveMinRanges,
+                                                                 settings.WholeArchiveRequestCost);
+        scheduler_ = std::make_unique<DownloadScheduler>(settings.MaxConcurrentDownloads,
+                                                         settings.MaxConcurrentDownloadsPerServer);
+    });
+}
+
+HttpSessionPool& CDN::HttpSessions() { CreateComponents(); return *httpSessions_; }
+CacheManager& CDN::Cache() { CreateComponents(); return *cache_; }
+HotObjectCache& CDN::HotObjects() { CreateComponents(); return *hotObjects_; }
+ArchivePrefetchPolicy& CDN::ArchivePolicy() { CreateComponents(); return *archivePolicy_; }
+DownloadScheduler& CDN::Scheduler() { CreateComponents(); return *scheduler_; }
+
+BLTEDecodeOptions CDN::DecodeOptions() const {
+    BLTEDecodeOptions options;
+    options.verifyChecksums = settings_->VerifyChecksums;
+    return options;
+}
 
-CDN::CDN(const Settings &settings)
-    : settings_(settings) {
+void CDN::SetMirror(const std::filesystem::path &dir) {
+    if (!std::filesystem::is_directory(dir))
+        throw std::runtime_error("CDN mirror " + dir.string() + " is not a directory");
+    settings_->MirrorDir = dir;
+    mirror_ = std::make_unique<CDNMirror>(dir);
 }
 
 void CDN::OpenLocal() {
-    if (settings_.BaseDir.has_value())
+    if (!settings_->BaseDir.has_value())
         return;
 
     try {
@@ -58,11 +127,25 @@ void CDN::OpenLocal() {
 }
 
 void CDN::SetCDNs(const std::vector<std::string> &cdns) {
+    AddCDNs(cdns);
+
+    // Hosts from .build.info arrive before the product directory is known, setProductDirectory probes those
+    if (!productDirectory_.empty())
+        serverRanking_.ProbeNewServers(productDirectory_);
+}
+
+void CDN::setProductDirectory(const std::string &value) {
+    productDirectory_ = value;
+    serverRanking_.ProbeNewServers(productDirectory_);
+}
+
+void CDN::AddCDNs(const std::vector<std::string> &cdns) {
     std::lock_guard<std::mutex> lock(cdnSettingMutex_);
     for (auto &url: cdns) {
         if (std::find(cdnServers_.begin(), cdnServers_.end(), url) == cdnServers_.end())
             cdnServers_.push_back(url);
     }
+    serverRanking_.AddServers(cdns);
 }
 
 std::string DownloadTextFromURL(const std::string &url) {
@@ -76,7 +159,7 @@ std::string DownloadTextFromURL(const std::string &url) {
 }
 
 std::string CDN::GetPatchServiceFile(const std::string &product, const std::string &file) {
-    std::string url = std::format("https://{}.version.battle.net/{}/{}", settings_.Region, product, file);
+    std::string url = std::format("https://{}.version.battle.net/{}/{}", settings_->Region, product, file);
     return DownloadTextFromURL(url);
 }
 
@@ -88,8 +171,8 @@ std::vector<uint8_t> CDN::GetFile(const std::string &type,
 
     auto data = DownloadFile(type, hash, "", 0, compressedSize);
     if (!decode)
-        return data;
-    return BLTE::Decode(data, decompressedSize);
+        return *data;
+    return BLTE::Decode(*data, decompressedSize, DecodeOptions());
 }
 
 std::vector<uint8_t> CDN::GetFileFromArchive(const std::string &eKey,
@@ -98,51 +181,393 @@ std::vector<uint8_t> CDN::GetFileFromArchive(const std::string &eKey,
                                              size_t length,
                                              uint64_t decompressedSize,
                                              bool decode) {
-    std::atomic<bool> cancel{false};
-    auto data = DownloadFile("", eKey, archive, offset, length, cancel);
+    auto data = DownloadFile("", eKey, archive, static_cast<int>(offset), length);
     if (!decode)
-        return data;
-    return BLTE::Decode(data, decompressedSize);
+        return *data;
+    return BLTE::Decode(*data, decompressedSize, DecodeOptions());
 }
 
-std::string CDN::GetFilePath(const std::string &type, const std::string &hash, uint64_t compressedSize) {
+CDN::Blob CDN::GetFileShared(const std::string &type, const std::string &hash, uint64_t compressedSize) {
+    return DownloadFile(type, hash, "", 0, compressedSize);
+}
+
+CDN::Blob CDN::GetFileFromArchiveShared(const std::string &eKey,
+                                        const std::string &archive,
+                                        size_t offset,
+                                        size_t length) {
+    return DownloadFile("", eKey, archive, static_cast<int>(offset), length);
+}
+
+std::shared_ptr<MemoryMappedFile> CDN::GetFileMapped(const std::string &type,
+                                                     const std::string &hash,
+                                                     uint64_t compressedSize) {
+    return MapCacheFile(type, hash, "", 0, compressedSize);
+}
+
+std::shared_ptr<MemoryMappedFile> CDN::GetFileFromArchiveMapped(const std::string &eKey,
+                                                                const std::string &archive,
+                                                                size_t offset,
+                                                                size_t length) {
+    return MapCacheFile("", eKey, archive, static_cast<int>(offset), length);
+}
+
+void CDN::StreamDecodedFile(const std::string &type,
+                            const std::string &hash,
+                            const DataSink &sink,
+                            uint64_t compressedSize,
+                            uint64_t decompressedSize) {
+    BLTEStreamDecoder decoder(sink, decompressedSize, settings_->VerifyChecksums);
+    StreamFile(type, hash, "", 0, compressedSize, [&](const uint8_t *data, size_t size) {
+        decoder.Feed(data, size);
+    });
+    decoder.Finish();
+}
+
+void CDN::StreamDecodedFileFromArchive(const std::string &eKey,
+                                       const std::string &archive,
+                                       size_t offset,
+                                       size_t length,
+                                       const DataSink &sink,
+                                       uint64_t decompressedSize) {
+    BLTEStreamDecoder decoder(sink, decompressedSize, settings_->VerifyChecksums);
+    StreamFile("", eKey, archive, offset, length, [&](const uint8_t *data, size_t size) {
+        decoder.Feed(data, size);
+    });
+    decoder.Finish();
+}
+
+std::future<std::vector<uint8_t>> CDN::GetFileAsync(const std::string &type,
+                                                    const std::string &hash,
+                                                    uint64_t compressedSize,
+                                                    uint64_t decompressedSize,
+                                                    bool decode,
+                                                    DownloadPriority priority) {
+    return Scheduler().Submit(priority, [=, this] {
+        return GetFile(type, hash, compressedSize, decompressedSize, decode);
+    });
+}
+
+std::future<std::vector<uint8_t>> CDN::GetFileFromArchiveAsync(const std::string &eKey,
+                                                               const std::string &archive,
+                                                               size_t offset,
+                                                               size_t length,
+                                                               uint64_t decompressedSize,
+                                                               bool decode,
+                                                               DownloadPriority priority) {
+    return Scheduler().Submit(priority, [=, this] {
+        return GetFileFromArchive(eKey, archive, offset, length, decompressedSize, decode);
+    });
+}
+
+std::vector<std::vector<uint8_t>> CDN::GetFilesFromArchives(const std::vector<ArchiveRange> &ranges) {
+    std::vector<std::vector<uint8_t>> result(ranges.size());
+    FetchArchiveRanges(ranges, [&](size_t index, std::vector<uint8_t> &data) {
+        result[index] = std::move(data);
+    });
+    return result;
+}
+
+void CDN::PrefetchFilesFromArchives(const std::vector<ArchiveRange> &ranges) {
+    FetchArchiveRanges(ranges, nullptr);
+}
+
+void CDN::FetchArchiveRanges(const std::vector<ArchiveRange> &ranges,
+                             const std::function<void(size_t index, std::vector<uint8_t> &data)> &onFile) {
+    // 1) Serve what is already on disk, group the rest by archive
+    std::unordered_map<std::string, std::vector<size_t>> missing;
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        const auto &range = ranges[i];
+        std::vector<uint8_t> data;
+
+        bool available = false;
+        if (auto blob = HotObjects().Find(range.archive, range.eKey); blob && blob->size() == range.length) {
+            available = true;
+            if (onFile)
+                data = *blob;
+        }
+
+        if (!available) {
+            if (auto slice = TryGetMirrorSlice("", range.eKey, range.archive, range.offset, range.length)) {
+                available = true;
+                if (onFile)
+                    data.assign(slice->bytes.begin(), slice->bytes.end());
+            }
+        }
+        if (!available)
+            available = TryGetLocalData("", range.eKey, range.archive, range.offset, range.length, data);
+        if (!available && !onFile) {
+            // Prefetching, no need to read the cached copy back
+            auto cachePath = GetCachePath("", range.eKey, range.archive);
+            std::error_code ec;
+            available = std::filesystem::file_size(cachePath, ec) == range.length && !ec;
+            if (available)
+                Cache().Touch(cachePath);
+        } else if (!available) {
+            available = TryGetCachedFile(GetCachePath("", range.eKey, range.archive), range.length, data);
+        }
+
+        if (!available)
+            missing[range.archive].push_back(i);
+        else if (onFile)
+            onFile(i, data);
+    }
+
+    if (missing.empty())
+        return;
 
-    std::filesystem::path cache = settings_.CacheDir / productDirectory_ / type / hash;
+    std::mutex resultMutex;
 
-    if (std::filesystem::exists(cache)) {
-        if (compressedSize > 0 && std::filesystem::file_size(cache) != compressedSize)
-            std::filesystem::remove(cache);
-        else
-            return cache.string();
+    {
+        std::scoped_lock lock(cdnLoadingMutex_);
+        if (cdnServers_.empty())
+            LoadCDNs();
     }
 
-    std::atomic<bool> cancel{false};
-    auto data = DownloadFile(type, hash, "", 0, compressedSize, cancel);
-    std::filesystem::create_directories(cache.parent_path());
-    std::ofstream ofs(cache, std::ios::binary);
-    ofs.write(reinterpret_cast<const char *>(data.data()), data.size());
-    return cache.string();
+    // 2) Merge ranges of each archive whose gap is small enough, one request per merged span
+    struct Span {
+        std::string         archive;
+        size_t              begin;
+        size_t              end;
+        std::vector<size_t> members;
+    };
+    std::vector<Span> spans;
+
+    for (auto &[archive, indices] : missing) {
+        // Archives that enough was asked from are fetched whole instead
+        uint64_t bytes = 0;
+        for (size_t index : indices)
+            bytes += ranges[index].length;
+        if (auto whole = WholeArchive(archive, indices.size(), bytes)) {
+            for (size_t index : indices) {
+                const auto &range = ranges[index];
+                if (range.offset + range.length > whole->size())
+                    throw std::runtime_error("Range of " + range.eKey + " is beyond the end of archive " + archive);
+                if (onFile) {
+                    auto begin = static_cast<const uint8_t *>(whole->data()) + range.offset;
+                    std::vector<uint8_t> data(begin, begin + range.length);
+                    std::scoped_lock lock(resultMutex);
+                    onFile(index, data);
+                }
+            }
+            continue;
+        }
+
+        std::sort(indices.begin(), indices.end(), [&](size_t a, size_t b) {
+            return ranges[a].offset < ranges[b].offset;
+        });
+
+        for (size_t index : indices) {
+            const auto &range = ranges[index];
+            size_t rangeEnd = range.offset + range.length;
+
+            if (!spans.empty() && spans.back().archive == archive &&
+                range.offset <= spans.back().end + settings_->RangeCoalesceGap &&
+                std::max(rangeEnd, spans.back().end) - spans.back().begin <= settings_->MaxCoalescedRangeSize) {
+                spans.back().end = std::max(spans.back().end, rangeEnd);
+                spans.back().members.push_back(index);
+            } else {
+                spans.push_back({archive, range.offset, rangeEnd, {index}});
+            }
+        }
+    }
+
+    // 3) Download spans on the network threads, slice them back into the requested blobs and cache those
+    std::vector<std::future<void>> downloads;
+    downloads.reserve(spans.size());
+    for (const auto &span : spans) {
+        downloads.push_back(Scheduler().Submit(DownloadPriority::Bulk, [&, &span = span] {
+            std::vector<uint8_t> buffer;
+            buffer.reserve(span.end - span.begin);
+            DownloadFromCDN("data", ranges[span.members.front()].eKey, span.archive,
+                            static_cast<int>(span.begin), span.end - span.begin, 0,
+                [&](const uint8_t *chunk, size_t size) {
+                    buffer.insert(buffer.end(), chunk, chunk + size);
+                });
+            if (buffer.size() != span.end - span.begin)
+                throw std::runtime_error("Short read downloading " + std::to_string(span.members.size()) +
+                                         " files from archive " + span.archive);
+
+            for (size_t index : span.members) {
+                const auto &range = ranges[index];
+                std::vector<uint8_t> data(buffer.begin() + (range.offset - span.begin),
+                                          buffer.begin() + (range.offset - span.begin + range.length));
+
+                auto cachePath = GetCachePath("", range.eKey, range.archive);
+                {
+                    std::scoped_lock lock(FileLock(cachePath));
+                    std::filesystem::create_directories(cachePath.parent_path());
+                    writeFileAtomic(cachePath, data);
+                    Cache().Added(cachePath);
+                }
+
+                if (onFile) {
+                    std::scoped_lock lock(resultMutex);
+                    onFile(index, data);
+                }
+            }
+        }));
+    }
+
+    // Wait for every span before rethrowing, the jobs reference this frame
+    std::exception_ptr error;
+    for (auto &download : downloads) {
+        try {
+            download.get();
+        } catch (...) {
+            if (!error)
+                error = std::current_exception();
+        }
+    }
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+std::vector<uint8_t> CDN::GetFileRangeFromArchive(const std::string &eKey,
+                                                  const std::string &archive,
+                                                  size_t offset,
+                                                  size_t length,
+                                                  uint64_t rangeOffset,
+                                                  uint64_t rangeLength,
+                                                  uint64_t decompressedSize) {
+    // Whole blob already in memory or on disk, only decoding can be saved
+    if (auto blob = HotObjects().Find(archive, eKey))
+        return BLTE::DecodeRange(*blob, rangeOffset, rangeLength, decompressedSize, DecodeOptions());
+
+    std::vector<uint8_t> data;
+    if (TryGetLocalData("", eKey, archive, offset, length, data) || TryGetCachedFile(GetCachePath("", eKey, archive), length, data) ||
+        TryGetFromWholeArchive(archive, offset, length, data))
+        return BLTE::DecodeRange(data, rangeOffset, rangeLength, decompressedSize, DecodeOptions());
+
+    {
+        std::scoped_lock lock(cdnLoadingMutex_);
+        if (cdnServers_.empty())
+            LoadCDNs();
+    }
+
+    // Partial ranges are not cached, the cache only ever holds complete blobs named by eKey
+    auto fetch = [&](size_t from, size_t size) {
+        std::vector<uint8_t> buf;
+        buf.reserve(size);
+        DownloadFromCDN("data", eKey, archive, static_cast<int>(offset + from), size, 0,
+            [&](const uint8_t *chunk, size_t chunkSize) {
+                buf.insert(buf.end(), chunk, chunk + chunkSize);
+            });
+        if (buf.size() != size)
+            throw std::runtime_error("Short read downloading range of " + eKey + " (archive " + archive + ")");
+        return buf;
+    };
+
+    // The chunk table usually fits in the first few KB, one round trip finds it
+    constexpr size_t headerProbeSize = 4096;
+    std::vector<uint8_t> encoded = fetch(0, std::min(length, headerProbeSize));
+    size_t encodedOffset = 0;
+
+    uint32_t headerSize = BLTE::ReadHeaderSize(encoded.data(), encoded.size());
+    if (headerSize == 0 || headerSize > encoded.size()) {
+        // Single-block blobs can't be split, grab whatever the probe didn't cover
+        size_t needed = headerSize == 0 ? length : headerSize;
+        if (needed > encoded.size()) {
+            auto rest = fetch(encoded.size(), needed - encoded.size());
+            encoded.insert(encoded.end(), rest.begin(), rest.end());
+        }
+        if (headerSize == 0)
+            return BLTE::DecodeRange(encoded, rangeOffset, rangeLength, decompressedSize, DecodeOptions());
+    }
+
+    auto header = BLTE::ParseHeader(encoded.data(), encoded.size());
+    auto [start, end] = BLTE::GetEncodedRange(header, rangeOffset, rangeLength);
+    if (end > length)
+        throw std::runtime_error("BLTE chunk table of " + eKey + " exceeds archive entry size");
+
+    if (end > encoded.size()) {
+        if (start >= encoded.size()) {
+            encoded = fetch(start, end - start);
+            encodedOffset = start;
+        } else {
+            auto rest = fetch(encoded.size(), end - encoded.size());
+            encoded.insert(encoded.end(), rest.begin(), rest.end());
+        }
+    }
+
+    return BLTE::DecodeRange(header, encoded.data(), encoded.size(), encodedOffset, rangeOffset, rangeLength,
+                             DecodeOptions());
+}
+
+std::string CDN::GetFilePath(const std::string &type, const std::string &hash, uint64_t compressedSize) {
+    // Whoever uses the path is out of sight of eviction, so it stays for good
+    auto path = CacheFile(type, hash, "", 0, compressedSize);
+    std::scoped_lock lock(FileLock(path));
+    if (!std::filesystem::exists(path))
+        path = CacheFile(type, hash, "", 0, compressedSize);  // evicted in between, the stripe is recursive
+    Cache().Pin(path);
+    return path.string();
 }
 
 std::string CDN::GetDecodedFilePath(const std::string &type,
                                     const std::string &hash,
                                     uint64_t compressedSize,
                                     uint64_t decompressedSize) {
-    std::filesystem::path path = settings_.CacheDir / productDirectory_ / type / (hash + ".decoded");
-    if (std::filesystem::exists(path))
+    // Like GetFilePath, the decoded file is pinned once its path is handed out
+    std::filesystem::path path = settings_->CacheDir / productDirectory_ / type / (hash + ".decoded");
+    auto tryExisting = [&] {
+        if (!std::filesystem::exists(path))
+            return false;
+        Cache().Touch(path);
+        Cache().Pin(path);
+        return true;
+    };
+    {
+        std::scoped_lock lock(FileLock(path));
+        if (tryExisting())
+            return path.string();
+    }
+
+    // Decode from a mapping of the cached encoded file, neither side is held in memory. Fetched before
+    // taking the decoded file's lock, stripes are shared and must not be taken in two orders.
+    auto encoded = MapCacheFile(type, hash, "", 0, compressedSize);
+    std::span<const uint8_t> data(static_cast<const uint8_t *>(encoded->data()), encoded->size());
+
+    std::scoped_lock lock(FileLock(path));
+    if (tryExisting())
         return path.string();
 
-    auto data = DownloadFile(type, hash, "", 0, compressedSize);
-    auto decoded = BLTE::Decode(data, decompressedSize);
-    std::ofstream ofs(path, std::ios::binary);
-    ofs.write(reinterpret_cast<const char *>(decoded.data()), decoded.size());
+    uint64_t decodedSize = decompressedSize != 0 ? decompressedSize : BLTE::GetDecodedSize(data);
+    if (decodedSize == 0) {
+        // Nothing to map, Decode reports single-block blobs without a known size
+        auto decoded = BLTE::Decode(std::vector<uint8_t>(data.begin(), data.end()), decompressedSize, DecodeOptions());
+        std::filesystem::create_directories(path.parent_path());
+        writeFileAtomic(path, decoded);
+        Cache().Added(path);
+        Cache().Pin(path);
+        return path.string();
+    }
+
+    // Decode straight into a mapped .part file instead of an intermediate vector, only a complete
+    // file is renamed into place
+    auto partPath = path;
+    partPath += ".part";
+    std::filesystem::create_directories(path.parent_path());
+    try {
+        MemoryMappedFile out(partPath.string(), true, static_cast<size_t>(decodedSize));
+        BLTE::Decode(data,
+                     std::span<uint8_t>(static_cast<uint8_t *>(out.data()), out.size()),
+                     DecodeOptions());
+    } catch (...) {
+        std::error_code ec;
+        std::filesystem::remove(partPath, ec);
+        throw;
+    }
+    std::filesystem::rename(partPath, path);
+    Cache().Added(path);
+    Cache().Pin(path);
     return path.string();
 }
 
 void CDN::LoadCDNs() {
     auto start = std::chrono::steady_clock::now();
 
-    std::string url = std::format("http://{}.patch.battle.net:1119/{}/cdns", settings_.Region, settings_.Product);
+    std::string url = std::format("http://{}.patch.battle.net:1119/{}/cdns", settings_->Region, settings_->Product);
 
     auto r = cpr::Get(cpr::Url(url));
     if (r.status_code != 200) {
@@ -177,44 +602,179 @@ void CDN::LoadCDNs() {
         for (auto &line: lines) {
             auto recordTokens = tokenize(line, "|");
 
-            if (recordTokens[NameIndex] != settings_.Region) continue;
+            if (recordTokens[NameIndex] != settings_->Region) continue;
 
             if (productDirectory_.empty())
                 productDirectory_ = recordTokens[PathIndex];
 
             auto servers = tokenize(recordTokens[HostsIndex], " ");
-            SetCDNs(servers);
+            AddCDNs(servers);
         }
     }
-    cdnServers_.push_back("archive.wow.tools");
+    AddCDNs({"archive.wow.tools"});
 
-    // TODO: ping measurement and sorting omitted for brevity
+    // All hosts at once, the probes run in parallel
+    serverRanking_.ProbeNewServers(productDirectory_);
     auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
         std::chrono::steady_clock::now() - start).count();
     std::cout << "Loaded and sorted CDNs in " << elapsed << "ms" << std::endl << std::flush;;
 }
 
 void CDN::LoadCASCIndices() {
-    if (!settings_.BaseDir.has_value()) return;
+    if (!settings_->BaseDir.has_value()) return;
 
-    std::filesystem::path dataDir = settings_.BaseDir.value();
+    std::filesystem::path dataDir = settings_->BaseDir.value();
     dataDir /= "Data/data";
 
     if (!std::filesystem::exists(dataDir)) return;
 
+    localArchives_ = std::make_unique<LocalArchivePool>(dataDir);
+
+    // 1) Buckets are named <bucket:2><version:8>.idx in hex. The client writes a new version on
+    //    every update and older ones may linger, only the highest is current.
+    std::map<uint8_t, std::pair<uint32_t, std::filesystem::path>> newest;
     for (auto &entry: std::filesystem::directory_iterator(dataDir)) {
         if (entry.path().extension() != ".idx") continue;
 
         auto name = entry.path().stem().string();
-        if (name.rfind("tempfile", 0) == 0) continue;
+        if (name.rfind("tempfile", 0) == 0 || name.size() != 10) continue;
 
-        uint8_t bucket = std::stoul(name.substr(0, 2), nullptr, 16);
-        cascIndices_.emplace(bucket,
-                             std::make_unique<CASCIndexInstance>(entry.path().string()));
+        uint32_t bucket = 0, version = 0;
+        if (std::from_chars(name.data(), name.data() + 2, bucket, 16).ec != std::errc() ||
+            std::from_chars(name.data() + 2, name.data() + name.size(), version, 16).ec != std::errc())
+            continue;
+
+        auto [it, inserted] = newest.try_emplace(static_cast<uint8_t>(bucket), version, entry.path());
+        if (!inserted && version > it->second.first)
+            it->second = {version, entry.path()};
+    }
+
+    // 2) Load the buckets in parallel, a broken one only costs its own entries
+    std::vector<std::pair<uint8_t, std::future<std::unique_ptr<CASCIndexInstance>>>> loads;
+    for (const auto &[bucket, file]: newest) {
+        loads.emplace_back(bucket, std::async(std::launch::async, [path = file.second]() {
+            return std::make_unique<CASCIndexInstance>(path.string());
+        }));
     }
+    for (auto &[bucket, load]: loads) {
+        try {
+            cascIndices_.emplace(bucket, load.get());
+        } catch (const std::exception &e) {
+            std::cerr << "Failed to load CASC index for bucket " << int(bucket) << ": " << e.what() << std::endl;
+        }
+    }
+
+    // 3) Optionally copy them into one sorted table and let go of the bucket files
+    if (settings_->MergeLocalIndices && !cascIndices_.empty()) {
+        std::vector<const CASCIndexInstance*> buckets;
+        for (const auto &[bucket, index]: cascIndices_)
+            buckets.push_back(index.get());
+
+        try {
+            cascMergedIndex_ = std::make_unique<CASCMergedIndex>(buckets);
+            cascIndices_.clear();
+        } catch (const std::exception &e) {
+            std::cerr << "Failed to merge CASC indices, using them per bucket: " << e.what() << std::endl;
+        }
+    }
+}
+
+std::optional<CDNMirror::Slice> CDN::TryGetMirrorSlice(const std::string& type, const std::string& key,
+                                                       const std::string& archive, size_t offset, size_t length) {
+    if (!mirror_)
+        return std::nullopt;
+
+    if (!archive.empty())
+        return mirror_->Map(productDirectory_, "data", archive, offset, length);
+
+    auto slice = mirror_->Map(productDirectory_, type, key);
+    if (slice && length != 0 && slice->bytes.size() != length)
+        return std::nullopt;
+    return slice;
+}
+
+bool CDN::TryGetLocalData(const std::string& type, const std::string& key, const std::string& archive,
+                          size_t offset, size_t length, std::vector<uint8_t>& outData) {
+    if (auto slice = TryGetMirrorSlice(type, key, archive, offset, length)) {
+        outData.assign(slice->bytes.begin(), slice->bytes.end());
+        return true;
+    }
+
+    if (!hasLocal_)
+        return false;
+
+    try {
+        if (archive.empty()) {
+            // Original local resolution logic for data/config
+            if (type == "data" && key.rfind(".index") == key.size() - 6) {
+                std::filesystem::path p = std::filesystem::path(settings_->BaseDir.value_or("")) / "Data" / "indices" / key;
+                if (settings_->BaseDir.has_value() && std::filesystem::exists(p)) {
+                    outData = readFile(p.string());
+                    return true;
+                }
+            } else if (type == "config" && key.size() >= 4) {
+                std::filesystem::path p =
+                    std::filesystem::path(settings_->BaseDir.value_or("")) / "Data" / "config" /
+                        key.substr(0,2) / key.substr(2,2) / key;
+
+                if (settings_->BaseDir.has_value() && std::filesystem::exists(p)) {
+                    outData = readFile(p.string());
+                    return true;
+                }
+            } else if (TryGetLocalFile(key, outData)) {
+                return true;
+            }
+        } else {
+            // Archive-based local lookup
+            if (TryGetLocalFile(key, outData)) {
+                return true;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to read local file: " << e.what() << std::endl;
+    }
+
+    return false;
 }
 
-std::vector<uint8_t> CDN::DownloadFile(
+std::recursive_mutex& CDN::FileLock(const std::filesystem::path& path) {
+    // Normalized so every spelling of a path maps to the same stripe
+    return fileLocks_[std::hash<std::string>{}(path.lexically_normal().string()) % fileLocks_.size()];
+}
+
+std::filesystem::path CDN::GetCachePath(const std::string& type, const std::string& key, const std::string& archive) const {
+    std::string fileType = archive.empty() ? type : "data";
+    return std::filesystem::path(settings_->CacheDir) / productDirectory_ / fileType / key;
+}
+
+bool CDN::TryGetCachedFile(const std::filesystem::path& cachePath, uint64_t expectedSize,
+                           std::vector<uint8_t>& outData) {
+    // Checked and read under the lock, so eviction or a download can't change the file in between
+    std::scoped_lock lock(FileLock(cachePath));
+    std::error_code ec;
+    auto size = std::filesystem::file_size(cachePath, ec);
+    if (ec)
+        return false;
+
+    bool valid = (expectedSize == 0 || size == expectedSize);
+    if (!valid) {
+        std::filesystem::remove(cachePath, ec);
+        Cache().Removed(cachePath);
+        return false;
+    }
+
+    // A short read means it is fetched again
+    outData.resize(size);
+    std::ifstream in(cachePath, std::ios::binary);
+    if (!in.read(reinterpret_cast<char*>(outData.data()), outData.size())) {
+        outData.clear();
+        return false;
+    }
+    Cache().Touch(cachePath);
+    return true;
+}
+
+CDN::Blob CDN::DownloadFile(
     const std::string& type,
     const std::string& key,
     const std::string& archive,
@@ -222,75 +782,420 @@ std::vector<uint8_t> CDN::DownloadFile(
     uint64_t expectedSize,
     int timeoutMs)
 {
-    // 1) Attempt local fetch
-    if (hasLocal_) {
-        try {
-            std::vector<uint8_t> data;
-            if (archive.empty()) {
-                // Original local resolution logic for data/config
-                if (type == "data" && key.rfind(".index") == key.size() - 6) {
-                    std::filesystem::path p = std::filesystem::path(settings_.BaseDir.value_or("")) / "Data" / "indices" / key;
-                    if (settings_.BaseDir.has_value() && std::filesystem::exists(p)) {
-                        return readFile(p.string());
-                    }
-                } else if (type == "config" && key.size() >= 4) {
-                    std::filesystem::path p =
-                        std::filesystem::path(settings_.BaseDir.value_or("")) / "Data" / "config" /
-                            key.substr(0,2) / key.substr(2,2) / key;
+    // 0) Recently fetched blobs are served from memory without touching the disk
+    if (auto blob = HotObjects().Find(archive, key); blob && (expectedSize == 0 || blob->size() == expectedSize))
+        return blob;
+
+    // Concurrent callers asking for the same bytes wait for the first one and share its blob
+    std::string flightKey = std::format("{}/{}/{}/{}/{}", type, key, archive, offset, expectedSize);
+    return inFlight_.Do(flightKey, [&]() -> Blob {
+        auto keep = [&](std::vector<uint8_t>&& bytes) {
+            auto blob = std::make_shared<const std::vector<uint8_t>>(std::move(bytes));
+            HotObjects().Insert(archive, key, blob);
+            return blob;
+        };
+
+        // 1) Attempt local fetch
+        std::vector<uint8_t> data;
+        if (TryGetLocalData(type, key, archive, offset, expectedSize, data))
+            return keep(std::move(data));
+
+        // 2) Ensure CDN list is loaded (so that the productDirectory is filled)
+        {
+            std::scoped_lock lock(cdnLoadingMutex_);
+            if (cdnServers_.empty())
+                LoadCDNs();
+        }
 
-                    if (settings_.BaseDir.has_value() && std::filesystem::exists(p)) {
-                        return readFile(p.string());
-                    }
-                } else if (TryGetLocalFile(key, data)) {
-                    return data;
-                }
-            } else {
-                // Archive-based local lookup
-                if (TryGetLocalFile(key, data)) {
-                    return data;
+        // 3) Check cache validity
+        std::filesystem::path cachePath = GetCachePath(type, key, archive);
+        if (TryGetCachedFile(cachePath, expectedSize, data))
+            return keep(std::move(data));
+
+        // 4) Archives that enough was asked from are fetched whole and served from a mapping
+        if (!archive.empty() && expectedSize != 0) {
+            if (auto whole = WholeArchive(archive, 1, expectedSize)) {
+                if (offset + expectedSize > whole->size())
+                    throw std::runtime_error("Range of " + key + " is beyond the end of archive " + archive);
+                auto begin = static_cast<const uint8_t*>(whole->data()) + offset;
+                return keep(std::vector<uint8_t>(begin, begin + expectedSize));
+            }
+        }
+
+        // 5) Download from CDN(s) into the cache, a caller with a different size or offset may have
+        //    finished it while we waited for the lock
+        std::scoped_lock lock(FileLock(cachePath));
+        if (std::filesystem::exists(cachePath) &&
+            (expectedSize == 0 || std::filesystem::file_size(cachePath) == expectedSize))
+            return keep(readFile(cachePath.string()));
+
+        std::vector<uint8_t> resultFile;
+        resultFile.reserve(expectedSize);
+        DownloadToCache(cachePath, archive.empty() ? type : "data", key, archive, offset, expectedSize, timeoutMs,
+            [&](const uint8_t* chunk, size_t size) {
+                resultFile.insert(resultFile.end(), chunk, chunk + size);
+            });
+
+        return keep(std::move(resultFile));
+    });
+}
+
+std::shared_ptr<MemoryMappedFile> CDN::WholeArchive(const std::string& archive, size_t ranges, uint64_t bytes) {
+    {
+        std::scoped_lock lock(wholeArchivesMutex_);
+        if (auto it = wholeArchives_.find(archive); it != wholeArchives_.end())
+            return it->second;
+    }
+
+    if (!ArchivePolicy().Record(archive, ranges, bytes, [this](const std::string& name) { return GetArchiveSize(name); }))
+        return nullptr;
+
+    // Concurrent callers wait for the one download of the archive and share its mapping
+    return wholeArchiveFlights_.Do(archive, [&]() -> std::shared_ptr<MemoryMappedFile> {
+        {
+            std::scoped_lock lock(wholeArchivesMutex_);
+            if (auto it = wholeArchives_.find(archive); it != wholeArchives_.end())
+                return it->second;
+        }
+
+        try {
+            uint64_t size = ArchivePolicy().ArchiveSize(archive);
+            std::filesystem::path cachePath = GetCachePath("data", archive, "");
+            auto map = [&] {
+                auto mapping = std::make_shared<MemoryMappedFile>(cachePath.string());
+                Cache().Pin(cachePath, mapping);
+                std::scoped_lock lock(wholeArchivesMutex_);
+                return wholeArchives_.try_emplace(archive, std::move(mapping)).first->second;
+            };
+
+            // 1) Fetched by an earlier run
+            {
+                std::scoped_lock lock(FileLock(cachePath));
+                std::error_code ec;
+                if (std::filesystem::file_size(cachePath, ec) == size && !ec) {
+                    Cache().Touch(cachePath);
+                    return map();
                 }
             }
+
+            // 2) Downloaded without the file lock, its stripe is shared with unrelated cache files that would
+            //    wait for the whole archive. The single-flight keeps it to one download, DownloadToCache only
+            //    locks to rename the finished file into place.
+            std::cout << "Fetching whole archive " << archive << " (" << size / (1024 * 1024) << " MB), "
+                      << "enough of it was requested as ranges" << std::endl << std::flush;
+            DownloadToCache(cachePath, "data", archive, "", 0, size, 0, [](const uint8_t*, size_t) {});
+
+            std::scoped_lock lock(FileLock(cachePath));
+            return map();
         } catch (const std::exception& e) {
-            std::cerr << "Failed to read local file: " << e.what() << std::endl;
+            std::cerr << "Failed to fetch archive " << archive << " whole, staying with ranges: " << e.what() << std::endl;
+            ArchivePolicy().Failed(archive);
+            return nullptr;
         }
+    });
+}
+
+bool CDN::TryGetFromWholeArchive(const std::string& archive, size_t offset, size_t length,
+                                 std::vector<uint8_t>& outData) {
+    std::scoped_lock lock(wholeArchivesMutex_);
+    auto it = wholeArchives_.find(archive);
+    if (it == wholeArchives_.end() || offset + length > it->second->size())
+        return false;
+
+    auto begin = static_cast<const uint8_t*>(it->second->data()) + offset;
+    outData.assign(begin, begin + length);
+    return true;
+}
+
+uint64_t CDN::GetArchiveSize(const std::string& archive) {
+    for (const auto& server : serverRanking_.Ranked()) {
+        auto r = cpr::Head(cpr::Url{GetCDNUrl(server, "data", "", archive)}, cpr::Timeout{5000});
+        if (r.status_code != 200 || r.error)
+            continue;
+
+        auto it = r.header.find("Content-Length");
+        if (it != r.header.end())
+            return std::strtoull(it->second.c_str(), nullptr, 10);
     }
+    return 0;
+}
 
-    // 4) Ensure CDN list is loaded (so that the productDirectory is filled)
+std::shared_ptr<MemoryMappedFile> CDN::MapCacheFile(
+    const std::string& type,
+    const std::string& key,
+    const std::string& archive,
+    int offset,
+    uint64_t expectedSize)
+{
+    auto path = CacheFile(type, key, archive, offset, expectedSize);
+    std::scoped_lock lock(FileLock(path));
+    if (!std::filesystem::exists(path))
+        path = CacheFile(type, key, archive, offset, expectedSize);  // evicted in between, the stripe is recursive
+
+    auto mapping = std::make_shared<MemoryMappedFile>(path.string());
+    Cache().Pin(path, mapping);
+    return mapping;
+}
+
+std::filesystem::path CDN::CacheFile(
+    const std::string& type,
+    const std::string& key,
+    const std::string& archive,
+    int offset,
+    uint64_t expectedSize,
+    int timeoutMs)
+{
+    // 0) Mirrored loose files are used in place, no copy in the cache
+    if (archive.empty() && mirror_) {
+        if (auto path = mirror_->Resolve(productDirectory_, type, key)) {
+            std::error_code ec;
+            if (expectedSize == 0 || std::filesystem::file_size(*path, ec) == expectedSize)
+                return *path;
+        }
+    }
+
+    // 1) Ensure CDN list is loaded (so that the productDirectory is filled)
     {
         std::scoped_lock lock(cdnLoadingMutex_);
         if (cdnServers_.empty())
             LoadCDNs();
     }
 
-    // 2) Prepare cache path
-    std::string fileType = archive.empty() ? type : "data";
-    std::filesystem::path cacheDir = std::filesystem::path(settings_.CacheDir) / productDirectory_ / fileType;
-    std::filesystem::path cachePath = cacheDir / key;
+    // 2) Check cache validity
+    std::filesystem::path cachePath = GetCachePath(type, key, archive);
+    auto isCached = [&] {
+        std::error_code ec;
+        auto size = std::filesystem::file_size(cachePath, ec);
+        return !ec && (expectedSize == 0 || size == expectedSize);
+    };
+    if (isCached()) {
+        Cache().Touch(cachePath);
+        return cachePath;
+    }
+
+    // 3) Local data has no file of its own to map, so it is copied into the cache
+    std::vector<uint8_t> data;
+    std::scoped_lock lock(FileLock(cachePath));
+    if (isCached())
+        return cachePath;
+    if (TryGetLocalData(type, key, archive, offset, expectedSize, data)) {
+        std::filesystem::create_directories(cachePath.parent_path());
+        writeFileAtomic(cachePath, data);
+        Cache().Added(cachePath);
+        return cachePath;
+    }
+
+    // 4) Stream the download to disk, nothing is kept in memory
+    DownloadToCache(cachePath, archive.empty() ? type : "data", key, archive, offset, expectedSize, timeoutMs,
+        [](const uint8_t*, size_t) {});
+    return cachePath;
+}
+
+void CDN::StreamFile(
+    const std::string& type,
+    const std::string& key,
+    const std::string& archive,
+    int offset,
+    uint64_t expectedSize,
+    const DataSink& onData)
+{
+    constexpr size_t readBlockSize = 1024 * 1024;
+
+    // Mirrored files are handed over straight from their mapping
+    if (auto slice = TryGetMirrorSlice(type, key, archive, offset, expectedSize)) {
+        onData(slice->bytes.data(), slice->bytes.size());
+        return;
+    }
+
+    // As are files in the archives of a local install
+    if (hasLocal_ && (!archive.empty() || (type != "config" && !key.ends_with(".index")))) {
+        try {
+            if (auto view = TryGetLocalArchiveView(key)) {
+                onData(view->bytes.data(), view->bytes.size());
+                return;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Failed to read local file: " << e.what() << std::endl;
+        }
+    }
+
+    std::vector<uint8_t> data;
+    if (TryGetLocalData(type, key, archive, offset, expectedSize, data)) {
+        onData(data.data(), data.size());
+        return;
+    }
+
+    {
+        std::scoped_lock lock(cdnLoadingMutex_);
+        if (cdnServers_.empty())
+            LoadCDNs();
+    }
 
+    // Checked, read or downloaded under the lock, so eviction or another download can't change the file in between
+    std::filesystem::path cachePath = GetCachePath(type, key, archive);
+    std::scoped_lock lock(FileLock(cachePath));
 
-    // 3) Check cache validity
-    if (std::filesystem::exists(cachePath)) {
-        auto size = std::filesystem::file_size(cachePath);
-        bool valid = (expectedSize == 0 || size == expectedSize);
-        if (valid) {
-            std::scoped_lock<std::mutex> lock(fileLocks_[cachePath.string()]);
-            std::vector<uint8_t> buf(size);
+    std::error_code ec;
+    auto size = std::filesystem::file_size(cachePath, ec);
+    if (!ec) {
+        if (expectedSize == 0 || size == expectedSize) {
+            // Bytes already handed to onData can't be taken back, a short read is an error
             std::ifstream in(cachePath, std::ios::binary);
-            in.read(reinterpret_cast<char*>(buf.data()), buf.size());
-            return buf;
-        } else {
-            std::filesystem::remove(cachePath);
+            std::vector<uint8_t> block(std::min<size_t>(size, readBlockSize));
+            while (size > 0) {
+                size_t toRead = std::min<size_t>(size, block.size());
+                if (!in.read(reinterpret_cast<char*>(block.data()), toRead))
+                    throw std::runtime_error("Error reading file: " + cachePath.string());
+                onData(block.data(), toRead);
+                size -= toRead;
+            }
+            Cache().Touch(cachePath);
+            return;
         }
+        std::filesystem::remove(cachePath);
+        Cache().Removed(cachePath);
     }
 
-    // 5) Download from CDN(s)
-    for (const auto& server : cdnServers_) {
-        // URL segments
-        std::string seg1 = archive.empty() ? key.substr(0,2) : archive.substr(0,2);
-        std::string seg2 = archive.empty() ? key.substr(2,2) : archive.substr(2,2);
-        std::string resource = archive.empty() ? key : archive;
+    // Received bytes go to the cache file and the caller at the same time, nothing is buffered
+    DownloadToCache(cachePath, archive.empty() ? type : "data", key, archive, offset, expectedSize, 0, onData);
+}
+
+void CDN::DownloadToCache(
+    const std::filesystem::path& cachePath,
+    const std::string& fileType,
+    const std::string& key,
+    const std::string& archive,
+    int offset,
+    uint64_t expectedSize,
+    int timeoutMs,
+    const DataSink& onData)
+{
+    constexpr size_t readBlockSize = 1024 * 1024;
+
+    auto partPath = cachePath;
+    partPath += ".part";
+    std::filesystem::create_directories(cachePath.parent_path());
+
+    // 1) Pick up where an interrupted download stopped. Without an expected size a leftover
+    //    part can't be told apart from a complete one, so those start over.
+    uint64_t resumeFrom = 0;
+    std::error_code ec;
+    uint64_t partSize = std::filesystem::file_size(partPath, ec);
+    if (!ec && expectedSize != 0 && partSize <= expectedSize)
+        resumeFrom = partSize;
+    else
+        std::filesystem::remove(partPath, ec);
+
+    // 2) Hand the bytes kept from last time to the caller first. If the caller rejects them (e.g. a
+    //    checksum error) or they can't be read, they are no good for the next attempt either.
+    if (resumeFrom > 0) {
+        std::cout << "Resuming " << key << " at byte " << resumeFrom << " of " << expectedSize << std::endl << std::flush;
+
+        try {
+            std::ifstream in(partPath, std::ios::binary);
+            std::vector<uint8_t> block(std::min<uint64_t>(resumeFrom, readBlockSize));
+            for (uint64_t left = resumeFrom; left > 0;) {
+                size_t toRead = std::min<uint64_t>(left, block.size());
+                if (!in.read(reinterpret_cast<char*>(block.data()), toRead))
+                    throw std::runtime_error("Error reading file: " + partPath.string());
+                onData(block.data(), toRead);
+                left -= toRead;
+            }
+        } catch (...) {
+            std::filesystem::remove(partPath, ec);
+            throw;
+        }
+    }
 
-        std::string url = std::format("http://{}/{}/{}/{}/{}/{}", server, productDirectory_, fileType, seg1, seg2, resource);
+    // 3) Append the rest. If the transfer fails the part file keeps every byte received for the next
+    //    attempt, if writing or the caller fails it goes.
+    uint64_t size = resumeFrom;
+    {
+        std::ofstream out(partPath, std::ios::binary | std::ios::app);
+        if (!out)
+            throw std::runtime_error("Unable to open file: " + partPath.string());
+
+        if (expectedSize == 0 || resumeFrom < expectedSize) {
+            // A failed sink aborts the transfer, RequestFromServer rethrows it after libcurl returned
+            // and it isn't held against the server
+            bool sinkFailed = false;
+            try {
+                DownloadFromCDN(fileType, key, archive, offset, expectedSize, timeoutMs,
+                    [&](const uint8_t* chunk, size_t chunkSize) {
+                        try {
+                            if (!out.write(reinterpret_cast<const char*>(chunk), chunkSize))
+                                throw std::runtime_error("Error writing file: " + partPath.string());
+                            size += chunkSize;
+                            onData(chunk, chunkSize);
+                        } catch (...) {
+                            sinkFailed = true;
+                            throw;
+                        }
+                    }, resumeFrom);
+            } catch (...) {
+                if (sinkFailed) {
+                    out.close();
+                    std::filesystem::remove(partPath, ec);
+                }
+                throw;
+            }
+        }
+
+        if (!out.flush())
+            throw std::runtime_error("Error writing file: " + partPath.string());
+    }
+
+    if (expectedSize != 0 && size != expectedSize) {
+        std::filesystem::remove(partPath, ec);
+        throw std::runtime_error("Downloaded " + std::to_string(size) + " bytes of " + key +
+                                 ", expected " + std::to_string(expectedSize));
+    }
+
+    // 4) Only complete files ever appear under the cache path
+    std::scoped_lock lock(FileLock(cachePath));
+    std::filesystem::rename(partPath, cachePath);
+    Cache().Added(cachePath);
+}
+
+std::string CDN::GetCDNUrl(const std::string& server, const std::string& fileType,
+                           const std::string& key, const std::string& archive) const {
+    // URL segments
+    std::string seg1 = archive.empty() ? key.substr(0,2) : archive.substr(0,2);
+    std::string seg2 = archive.empty() ? key.substr(2,2) : archive.substr(2,2);
+    std::string resource = archive.empty() ? key : archive;
+
+    return std::format("http://{}/{}/{}/{}/{}/{}", server, productDirectory_, fileType, seg1, seg2, resource);
+}
+
+void CDN::DownloadFromCDN(
+    const std::string& fileType,
+    const std::string& key,
+    const std::string& archive,
+    int offset,
+    uint64_t expectedSize,
+    int timeoutMs,
+    const DataSink& onData,
+    uint64_t resumeFrom)
+{
+    // Bytes already handed to onData; when a server fails midway the next one is asked for the rest only
+    uint64_t delivered = resumeFrom;
+    auto rangeFrom = [&](uint64_t start) -> std::string {
+        if (!archive.empty())
+            return "bytes=" + std::to_string(static_cast<uint64_t>(offset) + start) + "-" +
+                   std::to_string(static_cast<uint64_t>(offset) + expectedSize - 1);
+        return start == 0 ? std::string() : "bytes=" + std::to_string(start) + "-";
+    };
+
+    BodySink forward = [&](const uint8_t* chunk, size_t size) {
+        onData(chunk, size);
+        delivered += size;
+        return true;
+    };
+
+    auto servers = serverRanking_.Ranked();
+    for (size_t i = 0; i < servers.size(); ++i) {
+        const auto& server = servers[i];
+        std::string url = GetCDNUrl(server, fileType, key, archive);
 
         if (!archive.empty()) {
             std::cout << "Downloading chunk " << key << " from " << url <<
@@ -299,79 +1204,241 @@ std::vector<uint8_t> CDN::DownloadFile(
             std::cout << "Downloading " << key << " from " << url << "(expected size " << expectedSize << " )" << std::endl << std::flush;
         }
 
-        // Build request
-        cpr::Session session;
-        session.SetUrl(cpr::Url{url});
-        if (timeoutMs > 0)
-            session.SetTimeout(cpr::Timeout{timeoutMs});
-        if (!archive.empty()) {
-            std::string rangeHeader = std::to_string(offset) + "-" + std::to_string(offset + expectedSize - 1);
-            session.SetHeader({{"Range", "bytes=" + rangeHeader}});
+        std::string range = rangeFrom(delivered);
+        if (settings_->HedgeRequests && i + 1 < servers.size()) {
+            bool usedBackup = false;
+            bool ok = HedgedRequestFromServers(server, servers[i + 1],
+                                               url, GetCDNUrl(servers[i + 1], fileType, key, archive),
+                                               range, timeoutMs, forward, usedBackup);
+            if (ok)
+                return;
+            if (usedBackup)
+                ++i;
+            continue;
         }
-        auto fileSize = session.GetDownloadFileLength();
 
-        size_t readOfs = 0;
-        std::vector<uint8_t> resultFile(fileSize > 0 ? fileSize : 0);
+        if (RequestFromServer(server, url, range, timeoutMs, forward))
+            return;
+    }
 
-        cpr::Response r = session.Download(cpr::WriteCallback([&](const std::string &data, intptr_t userdata) -> bool {
-            if (resultFile.size() < (readOfs + data.size())) resultFile.resize(readOfs + data.size());
+    throw std::runtime_error(
+        archive.empty()
+        ? "Exhausted all CDNs trying to download " + key
+        : "Exhausted all CDNs trying to download " + key + " (archive " + archive + ")");
+}
 
-            std::copy(data.begin(), data.end(), resultFile.begin() + readOfs);
+bool CDN::RequestFromServer(const std::string& server, const std::string& url, const std::string& range,
+                            int timeoutMs, const BodySink& onBody, const std::atomic<bool>* cancel,
+                            const std::function<void()>& onSent)
+{
+    auto slot = Scheduler().AcquireSlot(server);
+    if (onSent)
+        onSent();
+
+    // Build request on a pooled session, every option is reset since it may carry the previous request's
+    auto session = HttpSessions().Acquire(server);
+    session->SetUrl(cpr::Url{url});
+    session->SetTimeout(cpr::Timeout{timeoutMs > 0 ? timeoutMs : 0});
+    cpr::Header headers;
+    if (!range.empty())
+        headers["Range"] = range;
+    session->SetHeader(headers);
+
+    // The body of error responses must never reach onBody, so track the status line as headers arrive.
+    // A server ignoring Range answers 200 with the whole file, which is just as unusable.
+    long status = 0;
+    long okStatus = range.empty() ? 200 : 206;
+    session->SetHeaderCallback(cpr::HeaderCallback([&](const std::string &header, intptr_t) -> bool {
+        if (startsWith(header, "HTTP/")) {
+            auto parts = tokenize(header, " ");
+            status = parts.size() > 1 ? std::strtol(parts[1].c_str(), nullptr, 10) : 0;
+        }
+        return true;
+    }, 0));
 
-            readOfs += data.size();
-            return true;
+    // Lets a stalled request be cancelled before it produced any body
+    session->SetProgressCallback(cpr::ProgressCallback(
+        [cancel](cpr::cpr_off_t, cpr::cpr_off_t, cpr::cpr_off_t, cpr::cpr_off_t, intptr_t) -> bool {
+            return cancel == nullptr || !cancel->load();
         }, 0));
 
-        if (r.status_code == 200 || r.status_code == 206) {
-            // Write to cache
-
-            std::scoped_lock lock(fileLocks_[cachePath.string()]);
-            std::filesystem::create_directories(cacheDir);
-            std::ofstream out(cachePath, std::ios::binary);
-            out.write(reinterpret_cast<const char*>(resultFile.data()), resultFile.size());
+    auto requestStart = std::chrono::steady_clock::now();
+    double firstByteMs = -1;
+    auto elapsedMs = [&] {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - requestStart).count();
+    };
+
+    // Exceptions must not unwind through libcurl, a throwing sink aborts the transfer and is rethrown after it
+    uint64_t received = 0;
+    std::exception_ptr sinkError;
+    cpr::Response r = session->Download(cpr::WriteCallback([&](const std::string &data, intptr_t) -> bool {
+        if (status != okStatus)
+            return true;
+        if (cancel != nullptr && cancel->load())
+            return false;
+        if (firstByteMs < 0)
+            firstByteMs = elapsedMs();
 
-            return std::move(resultFile);
+        received += data.size();
+        try {
+            return onBody(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+        } catch (...) {
+            sinkError = std::current_exception();
+            return false;
         }
+    }, 0));
 
-        std::cerr << "HTTP " << r.status_code << " downloading " << key << " from " << server << '\n';
+    // Not the server's fault, keep it out of the ranking
+    if (sinkError) {
+        session.Discard();
+        std::rethrow_exception(sinkError);
     }
 
-    throw std::runtime_error(
-        archive.empty()
-        ? "Exhausted all CDNs trying to download " + key
-        : "Exhausted all CDNs trying to download " + key + " (archive " + archive + ")");
+    if (r.status_code == okStatus && !r.error) {
+        double totalMs = elapsedMs();
+        serverRanking_.RecordSuccess(server, firstByteMs < 0 ? totalMs : firstByteMs, received, totalMs);
+        return true;
+    }
+
+    // Don't hand a connection in an unknown state to the next request
+    if (r.error)
+        session.Discard();
+
+    if (cancel != nullptr && cancel->load())
+        return false;
+
+    // A missing file is the mirror's content, not its health; errors and timeouts demote it
+    if (r.error || r.status_code == 0 || r.status_code >= 500)
+        serverRanking_.RecordFailure(server);
+
+    std::cerr << "HTTP " << r.status_code << " downloading " << url << " from " << server << '\n';
+    return false;
 }
 
-std::string PadLeft(const std::string& input, std::size_t totalLength, char symbol) {
-    if (input.size() >= totalLength) {
-        return input;  // no padding needed
+bool CDN::HedgedRequestFromServers(const std::string& primary, const std::string& backup,
+                                   const std::string& primaryUrl, const std::string& backupUrl,
+                                   const std::string& range, int timeoutMs, const BodySink& onBody,
+                                   bool& usedBackup)
+{
+    // Shared with the racers, the loser may still be running after this returns
+    struct Race {
+        std::mutex              mutex;
+        std::condition_variable changed;
+        int                     owner = -1;  // racer whose body goes to onBody
+        bool                    sent[2]      = {false, false};  // got its download slot
+        bool                    finished[2]  = {false, false};
+        bool                    succeeded[2] = {false, false};
+        std::exception_ptr      error[2];                     // thrown by onBody, rethrown for the owner
+        std::atomic<bool>       cancel[2]    = {false, false};
+    };
+    auto race = std::make_shared<Race>();
+
+    // The first racer with body bytes owns the output and the other one is cancelled, so the body
+    // can still be streamed instead of buffering both copies to see which completes first
+    auto start = [&](int racer, std::string server, std::string url) {
+        return std::async(std::launch::async, [this, race, racer, server, url, range, timeoutMs, &onBody,
+                                               priority = DownloadScheduler::CurrentPriority()] {
+            DownloadScheduler::PriorityScope scope(priority);
+            bool ok = false;
+            std::exception_ptr error;
+            try {
+                ok = RequestFromServer(server, url, range, timeoutMs, [&](const uint8_t* data, size_t size) {
+                    {
+                        std::scoped_lock lock(race->mutex);
+                        if (race->owner == -1) {
+                            race->owner = racer;
+                            race->cancel[1 - racer] = true;
+                            race->changed.notify_all();
+                        }
+                        if (race->owner != racer)
+                            return false;
+                    }
+                    // Only reached by the owner, which is always waited for, so onBody is still alive
+                    return onBody(data, size);
+                }, &race->cancel[racer], [&] {
+                    std::scoped_lock lock(race->mutex);
+                    race->sent[racer] = true;
+                    race->changed.notify_all();
+                });
+            } catch (...) {
+                error = std::current_exception();
+            }
+
+            std::scoped_lock lock(race->mutex);
+            race->finished[racer]  = true;
+            race->succeeded[racer] = ok;
+            race->error[racer]     = error;
+            race->changed.notify_all();
+        });
+    };
+
+    std::future<void> racers[2];
+    racers[0] = start(0, primary, primaryUrl);
+
+    // The deadline is about the server, not about how long the request queued for a slot
+    std::unique_lock lock(race->mutex);
+    race->changed.wait(lock, [&] { return race->sent[0] || race->finished[0]; });
+    usedBackup = !race->changed.wait_for(lock, serverRanking_.HedgeDeadline(primary), [&] {
+        return race->owner != -1 || race->finished[0];
+    });
+    if (usedBackup) {
+        std::cout << "No response from " << primary << " within its p95, racing " << backup << std::endl << std::flush;
+        racers[1] = start(1, backup, backupUrl);
     }
-    // create a string of (totalLength - input.size()) zeros, then append input
-    return std::string(totalLength - input.size(), symbol) + input;
+
+    // Done once the owner finished, or every started racer failed without producing a body
+    race->changed.wait(lock, [&] {
+        if (race->owner != -1)
+            return race->finished[race->owner];
+        return race->finished[0] && (!usedBackup || race->finished[1]);
+    });
+    bool ok = race->owner != -1 ? race->succeeded[race->owner] : race->succeeded[0] || race->succeeded[1];
+    std::exception_ptr error = race->owner != -1 ? race->error[race->owner] : nullptr;
+    lock.unlock();
+
+    // The owner's future is ready; the loser was cancelled and is reaped later
+    std::scoped_lock losersLock(hedgeLosersMutex_);
+    std::erase_if(hedgeLosers_, [](const std::future<void>& f) {
+        return f.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    });
+    for (auto& racer : racers) {
+        if (racer.valid() && racer.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            hedgeLosers_.push_back(std::move(racer));
+    }
+
+    if (error)
+        std::rethrow_exception(error);
+    return ok;
 }
 
-bool CDN::TryGetLocalFile(const std::string &eKey, std::vector<uint8_t> &outData) {
+std::optional<LocalArchivePool::View> CDN::TryGetLocalArchiveView(const std::string &eKey) {
+    if (!localArchives_) return std::nullopt;
+
     auto bytes = hexToBytes(eKey);
 
-    uint8_t i = 0;
-    for (int idx = 0; idx < 9; ++idx) i ^= bytes[idx];
+    CASCIndexInstance::FileArchiveData info;
+    if (cascMergedIndex_) {
+        info = cascMergedIndex_->GetIndexInfo(bytes);
+    } else {
+        uint8_t i = 0;
+        for (int idx = 0; idx < 9; ++idx) i ^= bytes[idx];
 
-    uint8_t bucket = (i & 0xF) ^ (i >> 4);
+        uint8_t bucket = (i & 0xF) ^ (i >> 4);
 
-    auto it = cascIndices_.find(bucket);
-    if (it == cascIndices_.end()) return false;
+        auto it = cascIndices_.find(bucket);
+        if (it == cascIndices_.end()) return std::nullopt;
 
-    auto info = it->second->GetIndexInfo(bytes);
-    if (info.archiveOffset == (size_t) -1) return false;
+        info = it->second->GetIndexInfo(bytes);
+    }
+    if (info.archiveOffset == (size_t) -1) return std::nullopt;
+
+    return localArchives_->ReadEntry(info.archiveIndex, info.archiveOffset, info.archiveSize, bytes);
+}
 
-    std::filesystem::path archivePath =
-        settings_.BaseDir.value() / ("Data/data/data." + PadLeft(std::to_string(info.archiveIndex), 3, '0'));
+bool CDN::TryGetLocalFile(const std::string &eKey, std::vector<uint8_t> &outData) {
+    auto view = TryGetLocalArchiveView(eKey);
+    if (!view) return false;
 
-    size_t fileLen = std::filesystem::file_size(archivePath);
-    if (info.archiveOffset + info.archiveSize > fileLen) return false;
-    std::ifstream ifs(archivePath, std::ios::binary);
-    ifs.seekg(info.archiveOffset);
-    outData.resize(info.archiveSize);
-    ifs.read(reinterpret_cast<char *>(outData.data()), info.archiveSize);
+    outData.assign(view->bytes.begin(), view->bytes.end());
     return true;
 }
@@ -4,24 +4,50 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <array>
 #include <mutex>
 #include <memory>
 #include <future>
 #include <cstdint>
+#include <filesystem>
+#include <atomic>
+#include <functional>
 #include "Settings.h"
 #include "CASCIndexInstance.h"
+#include "MemoryMappedFile.h"
 #include "BLTE.h"
+#include "BLTEStreamDecoder.h"
+#include "HttpSessionPool.h"
+#include "CDNServerRanking.h"
+#include "DownloadScheduler.h"
+#include "CacheManager.h"
+#include "HotObjectCache.h"
+#include "SingleFlight.h"
+#include "ArchivePrefetchPolicy.h"
+#include "CDNMirror.h"
+#include "LocalArchivePool.h"
+#include "CASCMergedIndex.h"
 
 class CDN {
 public:
-    explicit CDN(const Settings& settings);
+    using DataSink = BLTEStreamDecoder::Sink;
+    using Blob     = HotObjectCache::Blob;
+
+    // settings is shared with the owner, changes to it apply to later calls
+    explicit CDN(std::shared_ptr<Settings> settings);
+    ~CDN();
 
     // Load local CASC indices if available
     void OpenLocal();
 
-    // Provide list of CDN server URLs
+    // Provide list of CDN server URLs. New hosts are probed for their round trip time here, or by
+    // setProductDirectory if it wasn't set yet.
     void SetCDNs(const std::vector<std::string>& cdns);
 
+    // Serve files from a local directory laid out like the CDN before going to the network.
+    // Set before the first request.
+    void SetMirror(const std::filesystem::path& dir);
+
     // Fetch from patch service
     std::string GetPatchServiceFile(const std::string& product, const std::string& file = "versions");
 
@@ -39,7 +65,85 @@ public:
                                             uint64_t decompressedSize = 0,
                                             bool decode = false);
 
-    // Ensure on-disk copy, return path
+    // Same as GetFile/GetFileFromArchive without decoding, but without copying: blobs fetched recently
+    // are shared with every other caller asking for them
+    Blob GetFileShared(const std::string& type,
+                       const std::string& hash,
+                       uint64_t compressedSize = 0);
+
+    Blob GetFileFromArchiveShared(const std::string& eKey,
+                                  const std::string& archive,
+                                  size_t offset,
+                                  size_t length);
+
+    // Same as GetFile/GetFileFromArchive without decoding, but the download is streamed to the cache
+    // and handed back as a read-only mapping, so memory use doesn't grow with the file size. The file
+    // isn't evicted while the mapping is alive.
+    std::shared_ptr<MemoryMappedFile> GetFileMapped(const std::string& type,
+                                                    const std::string& hash,
+                                                    uint64_t compressedSize = 0);
+
+    std::shared_ptr<MemoryMappedFile> GetFileFromArchiveMapped(const std::string& eKey,
+                                                               const std::string& archive,
+                                                               size_t offset,
+                                                               size_t length);
+
+    // Queue a download on the network threads instead of blocking the caller
+    std::future<std::vector<uint8_t>> GetFileAsync(const std::string& type,
+                                                   const std::string& hash,
+                                                   uint64_t compressedSize = 0,
+                                                   uint64_t decompressedSize = 0,
+                                                   bool decode = false,
+                                                   DownloadPriority priority = DownloadPriority::Normal);
+
+    std::future<std::vector<uint8_t>> GetFileFromArchiveAsync(const std::string& eKey,
+                                                              const std::string& archive,
+                                                              size_t offset,
+                                                              size_t length,
+                                                              uint64_t decompressedSize = 0,
+                                                              bool decode = false,
+                                                              DownloadPriority priority = DownloadPriority::Bulk);
+
+    struct ArchiveRange {
+        std::string eKey;
+        std::string archive;
+        size_t      offset;
+        size_t      length;
+    };
+
+    // Fetch many archived blobs at once. Ranges of the same archive that are less than
+    // Settings::RangeCoalesceGap apart are downloaded with a single request and sliced apart again.
+    // Returns the encoded blobs in input order; every blob is cached like GetFileFromArchive does.
+    std::vector<std::vector<uint8_t>> GetFilesFromArchives(const std::vector<ArchiveRange>& ranges);
+
+    // Same as GetFilesFromArchives, but only fills the cache
+    void PrefetchFilesFromArchives(const std::vector<ArchiveRange>& ranges);
+
+    // Decode only decoded bytes [rangeOffset, rangeOffset + rangeLength) of an archived file,
+    // downloading just the chunk table and the chunks covering the range
+    std::vector<uint8_t> GetFileRangeFromArchive(const std::string& eKey,
+                                                 const std::string& archive,
+                                                 size_t offset,
+                                                 size_t length,
+                                                 uint64_t rangeOffset,
+                                                 uint64_t rangeLength,
+                                                 uint64_t decompressedSize = 0);
+
+    // Decode while downloading, handing decoded bytes to sink without holding the whole file
+    void StreamDecodedFile(const std::string& type,
+                           const std::string& hash,
+                           const DataSink& sink,
+                           uint64_t compressedSize = 0,
+                           uint64_t decompressedSize = 0);
+
+    void StreamDecodedFileFromArchive(const std::string& eKey,
+                                      const std::string& archive,
+                                      size_t offset,
+                                      size_t length,
+                                      const DataSink& sink,
+                                      uint64_t decompressedSize = 0);
+
+    // Ensure on-disk copy, return path. Files handed out by path are never evicted.
     std::string GetFilePath(const std::string& type,
                             const std::string& hash,
                             uint64_t compressedSize = 0);
@@ -51,13 +155,26 @@ public:
 
     // Flip product directory after LoadCDNs
     const std::string& ProductDirectory() const { return productDirectory_; }
-    void setProductDirectory(const std::string& value) { productDirectory_ = value; }
+    void setProductDirectory(const std::string& value);
 
 private:
+    // Adds hosts to the list and the ranking without probing them
+    void AddCDNs(const std::vector<std::string>& cdns);
     void LoadCDNs();
     void LoadCASCIndices();
 
-    std::vector<uint8_t> DownloadFile(
+    // Checks the hot object cache, local data, the cache directory and the CDN, in that order.
+    // Whatever was found is kept in the hot object cache.
+    Blob DownloadFile(
+        const std::string& type,
+        const std::string& key,
+        const std::string& archive = "",
+        int offset = 0,
+        uint64_t expectedSize = 0,
+        int timeoutMs = 0);
+
+    // Same lookup order as DownloadFile, but leaves the file in the cache instead of reading it into memory
+    std::filesystem::path CacheFile(
         const std::string& type,
         const std::string& key,
         const std::string& archive = "",
@@ -65,16 +182,134 @@ private:
         uint64_t expectedSize = 0,
         int timeoutMs = 0);
 
+    // CacheFile, mapped. The file is pinned against eviction for as long as the mapping lives.
+    std::shared_ptr<MemoryMappedFile> MapCacheFile(
+        const std::string& type,
+        const std::string& key,
+        const std::string& archive,
+        int offset,
+        uint64_t expectedSize);
+
+    // Same lookup order as DownloadFile, but hands raw bytes to onData as they are read/received
+    void StreamFile(
+        const std::string& type,
+        const std::string& key,
+        const std::string& archive,
+        int offset,
+        uint64_t expectedSize,
+        const DataSink& onData);
+
+    // Downloads into <cachePath>.part, resuming from what an earlier attempt left there, and renames
+    // it to cachePath once complete. onData sees the whole file, including the resumed bytes.
+    // Only a failed transfer leaves the part behind, not a failed write or an exception from onData.
+    // Callers hold the cache path's file lock, or otherwise make sure nobody else downloads the same file;
+    // the rename takes the lock either way.
+    void DownloadToCache(
+        const std::filesystem::path& cachePath,
+        const std::string& fileType,
+        const std::string& key,
+        const std::string& archive,
+        int offset,
+        uint64_t expectedSize,
+        int timeoutMs,
+        const DataSink& onData);
+
+    // Tries CDN servers best-ranked first, passing the body of the first successful response to onData.
+    // Starts resumeFrom bytes into the file; a server failing midway is resumed on the next with Range.
+    void DownloadFromCDN(
+        const std::string& fileType,
+        const std::string& key,
+        const std::string& archive,
+        int offset,
+        uint64_t expectedSize,
+        int timeoutMs,
+        const DataSink& onData,
+        uint64_t resumeFrom = 0);
+
+    // Returning false from a BodySink aborts the transfer. So does throwing, the exception is kept out
+    // of libcurl and rethrown by RequestFromServer once the transfer returned.
+    using BodySink = std::function<bool(const uint8_t* data, size_t size)>;
+
+    // One GET against one server, onBody only sees the body of a 200/206 response. Returns true if the
+    // whole body was received. cancel aborts the request even before the first body byte.
+    // onSent is called once the request got its download slot and goes out.
+    bool RequestFromServer(const std::string& server, const std::string& url, const std::string& range,
+                           int timeoutMs, const BodySink& onBody, const std::atomic<bool>* cancel = nullptr,
+                           const std::function<void()>& onSent = nullptr);
+
+    // Starts on primary and, if it hasn't sent body bytes within its p95 time to first byte of being
+    // sent, races the same request on backup. Time spent waiting for a download slot doesn't count. The first to deliver bytes wins, the other is cancelled.
+    // usedBackup tells whether backup was tried.
+    bool HedgedRequestFromServers(const std::string& primary, const std::string& backup,
+                                  const std::string& primaryUrl, const std::string& backupUrl,
+                                  const std::string& range, int timeoutMs, const BodySink& onBody,
+                                  bool& usedBackup);
+
+    std::string GetCDNUrl(const std::string& server, const std::string& fileType,
+                          const std::string& key, const std::string& archive) const;
+
+    // Mapping of archive if it is, or according to archivePolicy_ should now be, downloaded whole.
+    // nullptr means the ranges are to be requested individually.
+    std::shared_ptr<MemoryMappedFile> WholeArchive(const std::string& archive, size_t ranges, uint64_t bytes);
+
+    // Copies a range out of an archive that was already fetched whole, doesn't count towards the policy
+    bool TryGetFromWholeArchive(const std::string& archive, size_t offset, size_t length, std::vector<uint8_t>& outData);
+
+    // Content-Length of an archive on the first host that answers, 0 if none does
+    uint64_t GetArchiveSize(const std::string& archive);
+
+    // Hands every blob of ranges to onFile (if set) once it is available locally, cached or downloaded
+    void FetchArchiveRanges(const std::vector<ArchiveRange>& ranges,
+                            const std::function<void(size_t index, std::vector<uint8_t>& data)>& onFile);
+
+    // Mirror first, then the local install. offset and length are only used for archived files of the mirror.
+    bool TryGetLocalData(const std::string& type, const std::string& key, const std::string& archive,
+                         size_t offset, size_t length, std::vector<uint8_t>& outData);
+    std::optional<CDNMirror::Slice> TryGetMirrorSlice(const std::string& type, const std::string& key,
+                                                      const std::string& archive, size_t offset, size_t length);
+    bool TryGetCachedFile(const std::filesystem::path& cachePath, uint64_t expectedSize, std::vector<uint8_t>& outData);
+    // Held while a cache file is read or written. Paths share a fixed set of stripes, so unrelated
+    // files may briefly wait on each other but the table never grows.
+    std::recursive_mutex& FileLock(const std::filesystem::path& path);
+    std::filesystem::path GetCachePath(const std::string& type, const std::string& key, const std::string& archive) const;
+
+    void CreateComponents();
+    HttpSessionPool& HttpSessions();
+    CacheManager& Cache();
+    HotObjectCache& HotObjects();
+    ArchivePrefetchPolicy& ArchivePolicy();
+    DownloadScheduler& Scheduler();
+    BLTEDecodeOptions DecodeOptions() const;
+
     bool TryGetLocalFile(const std::string& eKey, std::vector<uint8_t>& outData);
+    // eKey's blob inside the local install's archives, without its record header, mapped where possible
+    std::optional<LocalArchivePool::View> TryGetLocalArchiveView(const std::string& eKey);
 
     std::vector<std::string> cdnServers_;
-    std::unordered_map<std::string, std::mutex> fileLocks_;
+    CDNServerRanking serverRanking_;
+    std::mutex hedgeLosersMutex_;
+    std::vector<std::future<void>> hedgeLosers_;
+    std::array<std::recursive_mutex, 1024> fileLocks_;
     std::mutex cdnLoadingMutex_;
     std::mutex cdnSettingMutex_;
     bool hasLocal_ = false;
     std::unordered_map<uint8_t, std::unique_ptr<CASCIndexInstance>> cascIndices_;
-    Settings settings_;
+    std::unique_ptr<CASCMergedIndex> cascMergedIndex_;  // replaces cascIndices_ with Settings::MergeLocalIndices
+    std::unique_ptr<LocalArchivePool> localArchives_;
+    std::unique_ptr<CDNMirror> mirror_;
+    std::shared_ptr<Settings> settings_;
+    // Sized from settings_ on first use, so limits set after construction still take effect
+    std::once_flag componentsOnce_;
+    std::unique_ptr<HttpSessionPool> httpSessions_;
+    std::unique_ptr<CacheManager> cache_;
+    std::unique_ptr<HotObjectCache> hotObjects_;
+    std::unique_ptr<ArchivePrefetchPolicy> archivePolicy_;
+    std::mutex wholeArchivesMutex_;
+    std::unordered_map<std::string, std::shared_ptr<MemoryMappedFile>> wholeArchives_;
+    SingleFlight<Blob> inFlight_;  // DownloadFile calls keyed by (type, key, archive, offset, size)
+    SingleFlight<std::shared_ptr<MemoryMappedFile>> wholeArchiveFlights_;  // whole-archive downloads by archive
     std::string productDirectory_;
+    std::unique_ptr<DownloadScheduler> scheduler_;  // last, so its network threads finish before anything they use goes away
 };
 
 #endif //CDN_H
@@ -0,0 +1,99 @@
+#include "CDNMirror.h"
+
+#include <iostream>
+
+CDNMirror::CDNMirror(std::filesystem::path root, size_t maxOpenFiles)
+    : root_(std::move(root)), maxOpenFiles_(maxOpenFiles) {
+}
+
+const std::vector<std::string>& CDNMirror::ProductDirectories() {
+    std::scoped_lock lock(mutex_);
+    if (!productDirectories_) {
+        productDirectories_.emplace();
+
+        std::error_code ec;
+        for (const auto& group : std::filesystem::directory_iterator(root_, ec)) {
+            if (!group.is_directory(ec))
+                continue;
+            for (const auto& product : std::filesystem::directory_iterator(group.path(), ec)) {
+                if (product.is_directory(ec))
+                    productDirectories_->push_back(group.path().filename().string() + "/" +
+                                                   product.path().filename().string());
+            }
+        }
+    }
+    return *productDirectories_;
+}
+
+std::optional<std::filesystem::path> CDNMirror::Resolve(const std::string& productDirectory,
+                                                        const std::string& type,
+                                                        const std::string& hash) {
+    if (hash.size() < 4)
+        return std::nullopt;
+
+    auto pathIn = [&](const std::string& directory) {
+        return root_ / directory / type / hash.substr(0, 2) / hash.substr(2, 2) / hash;
+    };
+
+    std::error_code ec;
+    if (!productDirectory.empty()) {
+        auto path = pathIn(productDirectory);
+        if (std::filesystem::is_regular_file(path, ec))
+            return path;
+        return std::nullopt;
+    }
+
+    for (const auto& directory : ProductDirectories()) {
+        auto path = pathIn(directory);
+        if (std::filesystem::is_regular_file(path, ec))
+            return path;
+    }
+    return std::nullopt;
+}
+
+std::shared_ptr<MemoryMappedFile> CDNMirror::Open(const std::filesystem::path& path) {
+    std::string key = path.string();
+
+    std::scoped_lock lock(mutex_);
+    if (auto it = openFileIndex_.find(key); it != openFileIndex_.end()) {
+        openFiles_.splice(openFiles_.begin(), openFiles_, it->second);
+        return it->second->second;
+    }
+
+    std::shared_ptr<MemoryMappedFile> file;
+    try {
+        file = std::make_shared<MemoryMappedFile>(key);
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to map mirrored file " << key << ": " << e.what() << std::endl;
+        return nullptr;
+    }
+
+    openFiles_.emplace_front(key, file);
+    openFileIndex_[key] = openFiles_.begin();
+
+    // Mappings still in use stay alive through their holders
+    while (openFiles_.size() > maxOpenFiles_) {
+        openFileIndex_.erase(openFiles_.back().first);
+        openFiles_.pop_back();
+    }
+    return file;
+}
+
+std::optional<CDNMirror::Slice> CDNMirror::Map(const std::string& productDirectory, const std::string& type,
+                                               const std::string& hash, size_t offset, size_t length) {
+    auto path = Resolve(productDirectory, type, hash);
+    if (!path)
+        return std::nullopt;
+
+    auto file = Open(*path);
+    if (!file || offset > file->size())
+        return std::nullopt;
+
+    if (length == 0)
+        length = file->size() - offset;
+    if (length > file->size() - offset)
+        return std::nullopt;
+
+    std::span<const uint8_t> bytes(static_cast<const uint8_t*>(file->data()) + offset, length);
+    return Slice{std::move(file), bytes};
+}
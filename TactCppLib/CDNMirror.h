@@ -0,0 +1,61 @@
+#ifndef CDNMIRROR_H
+#define CDNMIRROR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "MemoryMappedFile.h"
+
+// A local directory laid out like the CDN, <root>/<productDir>/<type>/ab/cd/<hash>, used as a
+// data source before any network access. Files are mapped rather than read, archive ranges are
+// handed out as slices of the mapping.
+class CDNMirror {
+public:
+    // Bytes inside a mapped mirror file, valid as long as file is held
+    struct Slice {
+        std::shared_ptr<MemoryMappedFile> file;
+        std::span<const uint8_t>          bytes;
+    };
+
+    explicit CDNMirror(std::filesystem::path root, size_t maxOpenFiles = 128);
+
+    CDNMirror(const CDNMirror&) = delete;
+    CDNMirror& operator=(const CDNMirror&) = delete;
+
+    // Where the mirror keeps hash. With an empty productDirectory every product directory found in the
+    // mirror is tried. Empty if the mirror doesn't have the file.
+    std::optional<std::filesystem::path> Resolve(const std::string& productDirectory, const std::string& type,
+                                                 const std::string& hash);
+
+    // [offset, offset + length) of a mirrored file, length 0 meaning up to its end.
+    // Empty if the file isn't mirrored or is too short.
+    std::optional<Slice> Map(const std::string& productDirectory, const std::string& type, const std::string& hash,
+                             size_t offset = 0, size_t length = 0);
+
+    const std::filesystem::path& Root() const { return root_; }
+
+private:
+    std::shared_ptr<MemoryMappedFile> Open(const std::filesystem::path& path);
+    const std::vector<std::string>& ProductDirectories();
+
+    std::filesystem::path root_;
+    size_t                maxOpenFiles_;
+
+    std::mutex mutex_;
+    std::optional<std::vector<std::string>> productDirectories_;  // <root>/*/*, listed on first use
+
+    // Recently used mappings, archives are hit over and over. Bounded since every mapping holds a descriptor.
+    std::list<std::pair<std::string, std::shared_ptr<MemoryMappedFile>>> openFiles_;  // most recent first
+    std::unordered_map<std::string, decltype(openFiles_)::iterator> openFileIndex_;
+};
+
+#endif //CDNMIRROR_H
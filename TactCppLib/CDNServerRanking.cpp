@@ -0,0 +1,151 @@
+#include "CDNServerRanking.h"
+
+#include <algorithm>
+#include <format>
+#include <future>
+#include <iostream>
+
+#ifndef __ANDROID__
+#include "cpr/cpr.h"
+#endif
+
+void CDNServerRanking::AddServers(const std::vector<std::string>& servers) {
+    std::scoped_lock lock(mutex_);
+    for (const auto& server : servers) {
+        if (stats_.contains(server))
+            continue;
+
+        stats_[server].order = servers_.size();
+        servers_.push_back(server);
+    }
+}
+
+void CDNServerRanking::ProbeNewServers(const std::string& productDirectory) {
+    // Only one thread probes, the others wait for its results instead of probing the same hosts
+    std::scoped_lock probeLock(probeMutex_);
+
+    std::vector<std::string> pending;
+    {
+        std::scoped_lock lock(mutex_);
+        for (const auto& server : servers_) {
+            auto& stats = stats_[server];
+            if (!stats.probed) {
+                stats.probed = true;
+                pending.push_back(server);
+            }
+        }
+    }
+    if (pending.empty())
+        return;
+
+    // Any response will do, even a 404 for the bare product directory tells us the round trip time
+    std::vector<std::future<void>> probes;
+    for (const auto& server : pending) {
+        probes.push_back(std::async(std::launch::async, [this, server, &productDirectory] {
+            auto r = cpr::Head(cpr::Url{std::format("http://{}/{}/", server, productDirectory)},
+                               cpr::Timeout{probeTimeout});
+            if (r.error || r.status_code == 0)
+                RecordFailure(server);
+            else
+                RecordSuccess(server, r.elapsed * 1000.0, 0, r.elapsed * 1000.0);
+        }));
+    }
+    for (auto& probe : probes)
+        probe.wait();
+
+    auto ranked = Ranked();
+    std::cout << "CDN ranking:";
+    for (const auto& server : ranked)
+        std::cout << ' ' << server << " (" << static_cast<int>(FirstByteMs(server)) << "ms)";
+    std::cout << std::endl << std::flush;
+}
+
+void CDNServerRanking::RecordSuccess(const std::string& server, double firstByteMs, uint64_t bytes, double totalMs) {
+    std::scoped_lock lock(mutex_);
+    auto& stats = stats_[server];
+
+    stats.firstByteMs = stats.measured
+        ? stats.firstByteMs + ewmaWeight * (firstByteMs - stats.firstByteMs)
+        : firstByteMs;
+    stats.measured = true;
+
+    stats.recentFirstByteMs.push_back(firstByteMs);
+    if (stats.recentFirstByteMs.size() > recentSampleCount)
+        stats.recentFirstByteMs.pop_front();
+
+    // Small bodies are all latency, they say nothing about bandwidth
+    double transferMs = totalMs - firstByteMs;
+    if (bytes >= minThroughputSample && transferMs > 0) {
+        double bytesPerMs = static_cast<double>(bytes) / transferMs;
+        stats.bytesPerMs = stats.bytesPerMs > 0
+            ? stats.bytesPerMs + ewmaWeight * (bytesPerMs - stats.bytesPerMs)
+            : bytesPerMs;
+    }
+
+    stats.failures = 0;
+    stats.demotedUntil = {};
+}
+
+void CDNServerRanking::RecordFailure(const std::string& server) {
+    std::scoped_lock lock(mutex_);
+    auto& stats = stats_[server];
+
+    stats.failures++;
+    auto demotion = baseDemotion * (1u << std::min<uint32_t>(stats.failures - 1, 16));
+    stats.demotedUntil = Clock::now() + std::min<Clock::duration>(demotion, maxDemotion);
+}
+
+std::vector<std::string> CDNServerRanking::Ranked() const {
+    std::scoped_lock lock(mutex_);
+    auto now = Clock::now();
+
+    std::vector<std::string> ranked = servers_;
+    std::stable_sort(ranked.begin(), ranked.end(), [&](const std::string& a, const std::string& b) {
+        const auto& sa = stats_.at(a);
+        const auto& sb = stats_.at(b);
+
+        bool demotedA = sa.demotedUntil > now;
+        bool demotedB = sb.demotedUntil > now;
+        if (demotedA != demotedB)
+            return demotedB;
+        if (demotedA)
+            return sa.demotedUntil < sb.demotedUntil;  // the one coming back first goes first
+        if (sa.measured != sb.measured)
+            return sa.measured;
+        if (!sa.measured)
+            return sa.order < sb.order;
+        return Score(sa) < Score(sb);
+    });
+    return ranked;
+}
+
+double CDNServerRanking::FirstByteMs(const std::string& server) const {
+    std::scoped_lock lock(mutex_);
+    auto it = stats_.find(server);
+    return it != stats_.end() && it->second.measured ? it->second.firstByteMs : 0;
+}
+
+std::chrono::milliseconds CDNServerRanking::HedgeDeadline(const std::string& server) const {
+    std::vector<double> samples;
+    {
+        std::scoped_lock lock(mutex_);
+        auto it = stats_.find(server);
+        if (it != stats_.end())
+            samples.assign(it->second.recentFirstByteMs.begin(), it->second.recentFirstByteMs.end());
+    }
+    if (samples.size() < minDeadlineSamples)
+        return defaultHedgeDeadline;
+
+    auto p95 = samples.begin() + (samples.size() * 95) / 100;
+    std::nth_element(samples.begin(), p95, samples.end());
+    auto deadline = std::chrono::milliseconds(static_cast<int64_t>(*p95));
+    return std::max(deadline, std::chrono::duration_cast<std::chrono::milliseconds>(minHedgeDeadline));
+}
+
+double CDNServerRanking::Score(const Stats& stats) {
+    // Expected time to fetch a typical range: latency plus transfer, if the bandwidth is known
+    double score = stats.firstByteMs;
+    if (stats.bytesPerMs > 0)
+        score += static_cast<double>(scoreReferenceSize) / stats.bytesPerMs;
+    return score;
+}
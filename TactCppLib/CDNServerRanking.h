@@ -0,0 +1,68 @@
+#ifndef CDNSERVERRANKING_H
+#define CDNSERVERRANKING_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Orders CDN hosts by how fast they have been. Every host gets one probe request, after that
+// real downloads keep a running EWMA of time to first byte and throughput. Hosts that error or
+// time out are pushed to the back of the list for a while, with exponential backoff.
+class CDNServerRanking {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void AddServers(const std::vector<std::string>& servers);
+
+    // Probe every host that hasn't been probed yet, in parallel. Blocks until all probes finished.
+    void ProbeNewServers(const std::string& productDirectory);
+
+    void RecordSuccess(const std::string& server, double firstByteMs, uint64_t bytes, double totalMs);
+    void RecordFailure(const std::string& server);
+
+    // Best host first. Unmeasured hosts follow measured ones, demoted hosts come last.
+    std::vector<std::string> Ranked() const;
+
+    // Smoothed time to first byte of server, 0 if it has no samples yet
+    double FirstByteMs(const std::string& server) const;
+
+    // p95 of the recent times to first byte of server, how long to wait before hedging a request to it.
+    // Falls back to a fixed deadline until there are enough samples.
+    std::chrono::milliseconds HedgeDeadline(const std::string& server) const;
+
+private:
+    struct Stats {
+        size_t            order       = 0;      // position in the original host list
+        bool              probed      = false;
+        bool              measured    = false;
+        double            firstByteMs = 0;      // EWMA
+        double            bytesPerMs  = 0;      // EWMA, 0 until a download was large enough to tell
+        uint32_t          failures    = 0;      // consecutive
+        Clock::time_point demotedUntil{};
+        std::deque<double> recentFirstByteMs;  // last recentSampleCount samples
+    };
+
+    static constexpr double   ewmaWeight          = 0.2;
+    static constexpr uint64_t minThroughputSample = 64 * 1024;
+    static constexpr uint64_t scoreReferenceSize  = 256 * 1024;  // typical archive range
+    static constexpr auto     probeTimeout        = std::chrono::milliseconds(2000);
+    static constexpr auto     baseDemotion        = std::chrono::seconds(5);
+    static constexpr auto     maxDemotion         = std::chrono::minutes(5);
+    static constexpr size_t   recentSampleCount   = 64;
+    static constexpr size_t   minDeadlineSamples  = 8;
+    static constexpr auto     defaultHedgeDeadline = std::chrono::milliseconds(1000);
+    static constexpr auto     minHedgeDeadline     = std::chrono::milliseconds(20);
+
+    static double Score(const Stats& stats);
+
+    mutable std::mutex mutex_;
+    std::mutex probeMutex_;
+    std::vector<std::string> servers_;
+    std::unordered_map<std::string, Stats> stats_;
+};
+
+#endif //CDNSERVERRANKING_H
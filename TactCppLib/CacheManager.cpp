@@ -0,0 +1,217 @@
+#include "CacheManager.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+CacheManager::CacheManager(std::filesystem::path cacheDir, uint64_t maxSize, TryRemove tryRemove)
+    : cacheDir_(cacheDir.lexically_normal()),
+      maxSize_(maxSize),
+      tryRemove_(std::move(tryRemove)) {
+    if (Enabled())
+        Load();
+}
+
+int64_t CacheManager::Now() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+std::string CacheManager::Key(const std::filesystem::path& path) const {
+    return path.lexically_normal().lexically_relative(cacheDir_).generic_string();
+}
+
+void CacheManager::Load() {
+    std::scoped_lock lock(mutex_);
+    std::filesystem::create_directories(cacheDir_);
+
+    // 1) Last access times from previous runs
+    std::unordered_map<std::string, int64_t> accessed;
+    {
+        std::ifstream in(cacheDir_ / journalName);
+        int64_t time;
+        std::string key;
+        while (in >> time && std::getline(in >> std::ws, key))
+            accessed[key] = time;
+    }
+
+    // 2) The directory is the truth for what exists, files the journal doesn't know are dated by mtime
+    std::error_code ec;
+    for (auto it = std::filesystem::recursive_directory_iterator(
+             cacheDir_, std::filesystem::directory_options::skip_permission_denied, ec);
+         !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+        if (!it->is_regular_file(ec) || it->path().extension() == ".part" || it->path().extension() == ".tmp")
+            continue;
+
+        std::string key = Key(it->path());
+        if (key == journalName)
+            continue;
+
+        Entry entry;
+        entry.size = it->file_size(ec);
+        if (auto found = accessed.find(key); found != accessed.end()) {
+            entry.lastAccess = found->second;
+        } else {
+            auto age = std::filesystem::file_time_type::clock::now() - it->last_write_time(ec);
+            entry.lastAccess = Now() - std::chrono::duration_cast<std::chrono::milliseconds>(age).count();
+        }
+
+        totalSize_ += entry.size;
+        entries_[key] = entry;
+    }
+
+    // 3) Start from a journal without stale records
+    Compact();
+    if (totalSize_ > maxSize_)
+        Evict({});
+}
+
+void CacheManager::Record(const std::string& key, int64_t lastAccess) {
+    journal_ << lastAccess << ' ' << key << '\n';
+    if (++journalRecords_ > 2 * entries_.size() + 1024)
+        Compact();
+}
+
+void CacheManager::Compact() {
+    auto journalPath = cacheDir_ / journalName;
+    auto tempPath = journalPath;
+    tempPath += ".tmp";
+
+    journal_.close();
+    {
+        std::ofstream out(tempPath, std::ios::trunc);
+        for (const auto& [key, entry] : entries_)
+            out << entry.lastAccess << ' ' << key << '\n';
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, journalPath, ec);
+    if (ec)
+        std::cerr << "Failed to write cache journal: " << ec.message() << std::endl;
+
+    journal_.open(journalPath, std::ios::app);
+    journalRecords_ = entries_.size();
+}
+
+void CacheManager::Touch(const std::filesystem::path& path) {
+    if (!Enabled())
+        return;
+
+    std::scoped_lock lock(mutex_);
+    std::string key = Key(path);
+    auto it = entries_.find(key);
+    if (it == entries_.end()) {
+        // Written by someone that didn't report it, e.g. index files saved by GroupIndex
+        std::error_code ec;
+        auto size = std::filesystem::file_size(path, ec);
+        if (ec)
+            return;
+        it = entries_.emplace(key, Entry{size, 0}).first;
+        totalSize_ += size;
+    }
+
+    it->second.lastAccess = Now();
+    Record(key, it->second.lastAccess);
+}
+
+void CacheManager::Added(const std::filesystem::path& path) {
+    if (!Enabled())
+        return;
+
+    std::error_code ec;
+    auto size = std::filesystem::file_size(path, ec);
+    if (ec)
+        return;
+
+    std::scoped_lock lock(mutex_);
+    std::string key = Key(path);
+    auto& entry = entries_[key];
+    totalSize_ = totalSize_ - entry.size + size;
+    entry.size = size;
+    entry.lastAccess = Now();
+    Record(key, entry.lastAccess);
+
+    if (totalSize_ > maxSize_)
+        Evict(key);
+}
+
+void CacheManager::Removed(const std::filesystem::path& path) {
+    if (!Enabled())
+        return;
+
+    std::scoped_lock lock(mutex_);
+    auto it = entries_.find(Key(path));
+    if (it == entries_.end())
+        return;
+
+    totalSize_ -= it->second.size;
+    entries_.erase(it);
+}
+
+void CacheManager::Pin(const std::filesystem::path& path) {
+    if (!Enabled())
+        return;
+
+    std::scoped_lock lock(mutex_);
+    pins_[Key(path)].permanent = true;
+}
+
+void CacheManager::Pin(const std::filesystem::path& path, std::weak_ptr<const void> owner) {
+    if (!Enabled())
+        return;
+
+    std::scoped_lock lock(mutex_);
+    pins_[Key(path)].owners.push_back(std::move(owner));
+}
+
+bool CacheManager::Pinned(const std::string& key) {
+    auto it = pins_.find(key);
+    if (it == pins_.end())
+        return false;
+
+    auto& pins = it->second;
+    std::erase_if(pins.owners, [](const auto& owner) { return owner.expired(); });
+    if (pins.permanent || !pins.owners.empty())
+        return true;
+    pins_.erase(it);
+    return false;
+}
+
+uint64_t CacheManager::Size() const {
+    std::scoped_lock lock(mutex_);
+    return totalSize_;
+}
+
+void CacheManager::Evict(const std::string& keep) {
+    // Oldest first, down to evictTo of the budget. The file that was just added is never a candidate.
+    std::vector<std::pair<int64_t, std::string>> candidates;
+    candidates.reserve(entries_.size());
+    for (const auto& [key, entry] : entries_) {
+        if (key != keep)
+            candidates.emplace_back(entry.lastAccess, key);
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    auto target = static_cast<uint64_t>(static_cast<double>(maxSize_) * evictTo);
+    size_t evicted = 0;
+    uint64_t evictedSize = 0;
+    for (const auto& [lastAccess, key] : candidates) {
+        if (totalSize_ <= target)
+            break;
+
+        // Files in use stay, they are picked up again by a later eviction
+        if (Pinned(key) || !tryRemove_(cacheDir_ / key))
+            continue;
+
+        auto it = entries_.find(key);
+        totalSize_ -= it->second.size;
+        evictedSize += it->second.size;
+        entries_.erase(it);
+        ++evicted;
+    }
+
+    if (evicted > 0)
+        std::cout << "Evicted " << evicted << " cache files (" << evictedSize / (1024 * 1024) << " MB), cache is now "
+                  << totalSize_ / (1024 * 1024) << " MB" << std::endl << std::flush;
+}
@@ -0,0 +1,81 @@
+#ifndef CACHEMANAGER_H
+#define CACHEMANAGER_H
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Keeps the cache directory under a size budget by removing least recently used files.
+// Sizes come from scanning the directory on start, last access times from an append-only
+// journal in the cache root, so the order survives restarts. A budget of 0 disables eviction.
+class CacheManager {
+public:
+    // Removes a cache file unless it is in use, returns whether it was removed
+    using TryRemove = std::function<bool(const std::filesystem::path& path)>;
+
+    CacheManager(std::filesystem::path cacheDir, uint64_t maxSize, TryRemove tryRemove);
+
+    CacheManager(const CacheManager&) = delete;
+    CacheManager& operator=(const CacheManager&) = delete;
+
+    bool Enabled() const { return maxSize_ != 0; }
+
+    // A cached file was read
+    void Touch(const std::filesystem::path& path);
+
+    // A file was written to the cache, evicts older files if that went over budget
+    void Added(const std::filesystem::path& path);
+
+    // A cached file was deleted by its owner
+    void Removed(const std::filesystem::path& path);
+
+    // Never evict path. For files handed out by path, whose users eviction can't see.
+    void Pin(const std::filesystem::path& path);
+
+    // Don't evict path while owner is alive, e.g. a mapping of it
+    void Pin(const std::filesystem::path& path, std::weak_ptr<const void> owner);
+
+    uint64_t Size() const;
+
+private:
+    struct Entry {
+        uint64_t size       = 0;
+        int64_t  lastAccess = 0;  // ms since epoch
+    };
+
+    struct Pins {
+        bool permanent = false;
+        std::vector<std::weak_ptr<const void>> owners;
+    };
+
+    static constexpr const char* journalName = "cache.journal";
+    static constexpr double      evictTo     = 0.9;  // of maxSize_, so eviction doesn't run on every add
+
+    void Load();
+    void Record(const std::string& key, int64_t lastAccess);
+    void Compact();
+    void Evict(const std::string& keep);
+    bool Pinned(const std::string& key);
+    std::string Key(const std::filesystem::path& path) const;
+
+    static int64_t Now();
+
+    std::filesystem::path cacheDir_;
+    uint64_t              maxSize_;
+    TryRemove             tryRemove_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;  // keyed by path relative to cacheDir_
+    std::unordered_map<std::string, Pins>  pins_;     // same keys
+    uint64_t      totalSize_ = 0;
+    std::ofstream journal_;
+    size_t        journalRecords_ = 0;
+};
+
+#endif //CACHEMANAGER_H
@@ -0,0 +1,132 @@
+#include "DownloadScheduler.h"
+
+#include <algorithm>
+
+namespace {
+    thread_local DownloadPriority currentPriority = DownloadPriority::Normal;
+}
+
+DownloadScheduler::DownloadScheduler(size_t maxInFlight, size_t maxPerServer)
+    : maxInFlight_(std::max<size_t>(maxInFlight, 1)), maxPerServer_(std::max<size_t>(maxPerServer, 1)) {
+}
+
+DownloadScheduler::~DownloadScheduler() {
+    {
+        std::scoped_lock lock(mutex_);
+        stopping_ = true;
+    }
+    queueChanged_.notify_all();
+
+    // Queued jobs still run, their futures would otherwise never become ready
+    for (auto& worker : workers_)
+        worker.join();
+}
+
+void DownloadScheduler::Post(DownloadPriority priority, std::function<void()> job) {
+    {
+        std::scoped_lock lock(mutex_);
+        queues_[static_cast<size_t>(priority)].push_back(std::move(job));
+
+        // One network thread per request slot, so queued jobs never oversubscribe the slots
+        if (workers_.empty()) {
+            for (size_t i = 0; i < maxInFlight_; ++i)
+                workers_.emplace_back(&DownloadScheduler::WorkerLoop, this);
+        }
+    }
+    queueChanged_.notify_one();
+}
+
+void DownloadScheduler::WorkerLoop() {
+    while (true) {
+        std::function<void()> job;
+        DownloadPriority priority;
+        {
+            std::unique_lock lock(mutex_);
+            queueChanged_.wait(lock, [&] {
+                return stopping_ || std::any_of(queues_.begin(), queues_.end(), [](const auto& q) { return !q.empty(); });
+            });
+
+            auto queue = std::find_if(queues_.begin(), queues_.end(), [](const auto& q) { return !q.empty(); });
+            if (queue == queues_.end())
+                return;  // stopping and drained
+
+            job = std::move(queue->front());
+            queue->pop_front();
+            priority = static_cast<DownloadPriority>(queue - queues_.begin());
+        }
+
+        // Requests the job makes keep its priority
+        PriorityScope scope(priority);
+
+        // Submit wraps jobs in a packaged_task, exceptions of Post jobs are theirs to handle
+        try {
+            job();
+        } catch (...) {
+        }
+    }
+}
+
+DownloadScheduler::Slot::Slot(DownloadScheduler* scheduler, std::string server)
+    : scheduler_(scheduler), server_(std::move(server)) {
+}
+
+DownloadScheduler::Slot::Slot(Slot&& other) noexcept
+    : scheduler_(other.scheduler_), server_(std::move(other.server_)) {
+    other.scheduler_ = nullptr;
+}
+
+DownloadScheduler::Slot::~Slot() {
+    if (scheduler_)
+        scheduler_->ReleaseSlot(server_);
+}
+
+DownloadPriority DownloadScheduler::CurrentPriority() {
+    return currentPriority;
+}
+
+DownloadScheduler::PriorityScope::PriorityScope(DownloadPriority priority)
+    : previous_(currentPriority) {
+    currentPriority = priority;
+}
+
+DownloadScheduler::PriorityScope::~PriorityScope() {
+    currentPriority = previous_;
+}
+
+DownloadScheduler::Slot DownloadScheduler::AcquireSlot(const std::string& server, DownloadPriority priority) {
+    std::unique_lock lock(mutex_);
+    auto& waiting = waiting_[static_cast<size_t>(priority)];
+    waiting[server]++;
+    slotsChanged_.wait(lock, [&] {
+        return inFlight_ < maxInFlight_ && inFlightPerServer_[server] < maxPerServer_ && !HigherPriorityWaiting(priority);
+    });
+    if (--waiting[server] == 0)
+        waiting.erase(server);
+
+    inFlight_++;
+    inFlightPerServer_[server]++;
+
+    // Lower priority waiters held back by this one may go now
+    lock.unlock();
+    slotsChanged_.notify_all();
+    return Slot(this, server);
+}
+
+bool DownloadScheduler::HigherPriorityWaiting(DownloadPriority priority) {
+    for (size_t higher = 0; higher < static_cast<size_t>(priority); ++higher) {
+        for (const auto& [server, count] : waiting_[higher]) {
+            if (inFlightPerServer_[server] < maxPerServer_)
+                return true;
+        }
+    }
+    return false;
+}
+
+void DownloadScheduler::ReleaseSlot(const std::string& server) {
+    {
+        std::scoped_lock lock(mutex_);
+        inFlight_--;
+        inFlightPerServer_[server]--;
+    }
+    slotsChanged_.notify_all();
+}
@@ -0,0 +1,106 @@
+#ifndef DOWNLOADSCHEDULER_H
+#define DOWNLOADSCHEDULER_H
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// Queued downloads run in this order, FIFO within a class. Requests waiting for a slot get it in this order too.
+enum class DownloadPriority {
+    Metadata,   // configs, indices, encoding, root
+    Normal,
+    Bulk        // file data
+};
+
+// Network side of the CDN: a fixed set of network threads runs queued download jobs by priority,
+// and every request on the wire holds a slot, capped globally and per server.
+// Jobs must not wait on other jobs' futures, they could be queued behind the waiting job.
+class DownloadScheduler {
+public:
+    DownloadScheduler(size_t maxInFlight, size_t maxPerServer);
+    ~DownloadScheduler();
+
+    DownloadScheduler(const DownloadScheduler&) = delete;
+    DownloadScheduler& operator=(const DownloadScheduler&) = delete;
+
+    // Run job on a network thread, the future carries its result or exception
+    template<typename Job>
+    auto Submit(DownloadPriority priority, Job&& job) -> std::future<std::invoke_result_t<Job>> {
+        using Result = std::invoke_result_t<Job>;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Job>(job));
+        auto future = task->get_future();
+        Post(priority, [task] { (*task)(); });
+        return future;
+    }
+
+    // Fire-and-forget variant, job reports back through its own callbacks
+    void Post(DownloadPriority priority, std::function<void()> job);
+
+    // A request slot, released when it goes out of scope
+    class Slot {
+    public:
+        Slot(Slot&& other) noexcept;
+        Slot& operator=(Slot&&) = delete;
+        ~Slot();
+
+    private:
+        friend class DownloadScheduler;
+        Slot(DownloadScheduler* scheduler, std::string server);
+
+        DownloadScheduler* scheduler_;
+        std::string        server_;
+    };
+
+    // Priority of the requests the calling thread makes. Normal unless a PriorityScope says otherwise,
+    // queued jobs run with the priority they were queued with.
+    static DownloadPriority CurrentPriority();
+
+    // Sets the calling thread's priority until it goes out of scope
+    class PriorityScope {
+    public:
+        explicit PriorityScope(DownloadPriority priority);
+        ~PriorityScope();
+
+        PriorityScope(const PriorityScope&) = delete;
+        PriorityScope& operator=(const PriorityScope&) = delete;
+
+    private:
+        DownloadPriority previous_;
+    };
+
+    // Blocks until both a global and a per-server slot are free and no request of a higher priority
+    // is waiting for them. Taken for every request, whether it runs on a network thread or on the caller's.
+    Slot AcquireSlot(const std::string& server, DownloadPriority priority = CurrentPriority());
+
+private:
+    void WorkerLoop();
+    void ReleaseSlot(const std::string& server);
+    // Whether a request above priority waits for a server that has a free slot. Called with mutex_ held.
+    bool HigherPriorityWaiting(DownloadPriority priority);
+
+    size_t maxInFlight_;
+    size_t maxPerServer_;
+
+    std::mutex mutex_;
+    std::condition_variable queueChanged_;
+    std::condition_variable slotsChanged_;
+    std::array<std::deque<std::function<void()>>, 3> queues_;  // indexed by DownloadPriority
+    size_t inFlight_ = 0;
+    std::unordered_map<std::string, size_t> inFlightPerServer_;
+    std::array<std::unordered_map<std::string, size_t>, 3> waiting_;  // AcquireSlot callers per server, by priority
+
+    std::vector<std::thread> workers_;  // started on first use
+    bool stopping_ = false;
+};
+
+#endif //DOWNLOADSCHEDULER_H
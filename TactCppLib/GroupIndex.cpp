@@ -14,83 +14,10 @@
 #include "IndexInstance.h"
 #include "utils/stringUtils.h"
 #include "utils/Bswap.h"
+#include "utils/MD5.h"
 
 std::string md5(const uint8_t* data, uint32_t length) {
-    static const uint32_t s[64] = {
-         7, 12, 17, 22,  7, 12, 17, 22,  7, 12, 17, 22,  7, 12, 17, 22,
-         5,  9, 14, 20,  5,  9, 14, 20,  5,  9, 14, 20,  5,  9, 14, 20,
-         4, 11, 16, 23,  4, 11, 16, 23,  4, 11, 16, 23,  4, 11, 16, 23,
-         6, 10, 15, 21,  6, 10, 15, 21,  6, 10, 15, 21,  6, 10, 15, 21
-    };
-    static const uint32_t K[64] = {
-        0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee,
-        0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
-        0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
-        0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
-        0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa,
-        0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
-        0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed,
-        0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
-        0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
-        0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
-        0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05,
-        0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
-        0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039,
-        0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
-        0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
-        0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
-    };
-    auto LEFTROTATE = [](uint32_t x, uint32_t c) { return (x << c) | (x >> (32 - c)); };
-
-    uint32_t h0 = 0x67452301;
-    uint32_t h1 = 0xefcdab89;
-    uint32_t h2 = 0x98badcfe;
-    uint32_t h3 = 0x10325476;
-
-    // Pre-processing
-    size_t new_len = ((((length + 8) / 64) + 1) * 64) - 8;
-    std::vector<uint8_t> msg(new_len + 8);
-    std::memcpy(msg.data(), data, length);
-    msg[length] = 0x80;
-    uint64_t bits_len = uint64_t(length) * 8;
-    std::memcpy(msg.data() + new_len, &bits_len, 8);
-
-    for (size_t offset = 0; offset < new_len; offset += 64) {
-        uint32_t w[16];
-        for (int j = 0; j < 16; ++j) {
-            std::memcpy(&w[j], msg.data() + offset + j*4, 4);
-        }
-        uint32_t a = h0, b = h1, c = h2, d = h3;
-        for (uint32_t i = 0; i < 64; ++i) {
-            uint32_t f, g;
-            if (i < 16) { f = (b & c) | ((~b) & d); g = i; }
-            else if (i < 32) { f = (d & b) | ((~d) & c); g = (5*i + 1) % 16; }
-            else if (i < 48) { f = b ^ c ^ d; g = (3*i + 5) % 16; }
-            else { f = c ^ (b | (~d)); g = (7*i) % 16; }
-            uint32_t temp = d;
-            d = c;
-            c = b;
-            uint32_t sum = a + f + K[i] + w[g];
-            b += LEFTROTATE(sum, s[i]);
-            a = temp;
-        }
-        h0 += a;
-        h1 += b;
-        h2 += c;
-        h3 += d;
-    }
-
-    char buf[33];
-    std::snprintf(buf, sizeof(buf),
-        "%02x%02x%02x%02x"
-        "%02x%02x%02x%02x"
-        "%02x%02x%02x%02x"
-        "%02x%02x%02x%02x",
-        h0 & 0xff, (h0 >> 8) & 0xff, (h0 >> 16) & 0xff, (h0 >> 24) & 0xff,
-        h1 & 0xff, (h1 >> 8) & 0xff, (h1 >> 16) & 0xff, (h1 >> 24) & 0xff,
-        h2 & 0xff, (h2 >> 8) & 0xff, (h2 >> 16) & 0xff, (h2 >> 24) & 0xff,
-        h3 & 0xff, (h3 >> 8) & 0xff, (h3 >> 16) & 0xff, (h3 >> 24) & 0xff);
-    return std::string(buf);
+    return MD5ToHexLower(MD5::Compute(data, length));
 }
 
 
@@ -124,6 +51,7 @@ std::string GroupIndex::Generate(
     std::vector<std::future<void>> futures;
     for (size_t archiveIndex = 0; archiveIndex < archives.size(); ++archiveIndex) {
         futures.emplace_back(std::async(std::launch::async, [&, archiveIndex]() {
+            DownloadScheduler::PriorityScope metadata(DownloadPriority::Metadata);
             const auto& name = archives[archiveIndex];
             std::string indexPath;
 
@@ -135,11 +63,8 @@ std::string GroupIndex::Generate(
                     indexPath = p.string();
                 }
             }
-            if (indexPath.empty()) {
-                cdn->GetFile("data", name + ".index");
-                indexPath = (std::filesystem::path(settings.CacheDir) / cdn->ProductDirectory() /
-                    "data" / (name + ".index")).string();
-            }
+            if (indexPath.empty())
+                indexPath = cdn->GetFilePath("data", name + ".index");
 
             IndexInstance idx(indexPath);
             auto all = idx.GetAllEntries();
@@ -0,0 +1,69 @@
+#include "HotObjectCache.h"
+
+#include <algorithm>
+#include <functional>
+
+HotObjectCache::HotObjectCache(size_t maxSize, size_t shardCount)
+    : shardBudget_(maxSize / std::max<size_t>(shardCount, 1)),
+      shards_(maxSize != 0 ? std::max<size_t>(shardCount, 1) : 0) {
+}
+
+std::string HotObjectCache::Key(const std::string& archive, const std::string& eKey) {
+    return archive.empty() ? eKey : archive + '/' + eKey;
+}
+
+HotObjectCache::Shard& HotObjectCache::ShardFor(const std::string& key) {
+    return shards_[std::hash<std::string>{}(key) % shards_.size()];
+}
+
+HotObjectCache::Blob HotObjectCache::Find(const std::string& archive, const std::string& eKey) {
+    if (shards_.empty())
+        return nullptr;
+
+    std::string key = Key(archive, eKey);
+    Shard& shard = ShardFor(key);
+    std::scoped_lock lock(shard.mutex);
+
+    auto it = shard.index.find(key);
+    if (it == shard.index.end())
+        return nullptr;
+
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    return it->second->second;
+}
+
+void HotObjectCache::Insert(const std::string& archive, const std::string& eKey, Blob blob) {
+    if (shards_.empty() || !blob || blob->size() > shardBudget_ / 4)
+        return;
+
+    std::string key = Key(archive, eKey);
+    Shard& shard = ShardFor(key);
+    std::scoped_lock lock(shard.mutex);
+
+    if (auto it = shard.index.find(key); it != shard.index.end()) {
+        shard.size -= it->second->second->size();
+        shard.lru.erase(it->second);
+        shard.index.erase(it);
+    }
+
+    shard.size += blob->size();
+    shard.lru.emplace_front(key, std::move(blob));
+    shard.index[shard.lru.front().first] = shard.lru.begin();
+
+    // Readers still holding an evicted blob keep it alive until they are done
+    while (shard.size > shardBudget_) {
+        auto& [oldKey, oldBlob] = shard.lru.back();
+        shard.size -= oldBlob->size();
+        shard.index.erase(oldKey);
+        shard.lru.pop_back();
+    }
+}
+
+void HotObjectCache::Clear() {
+    for (auto& shard : shards_) {
+        std::scoped_lock lock(shard.mutex);
+        shard.lru.clear();
+        shard.index.clear();
+        shard.size = 0;
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef HOTOBJECTCACHE_H
+#define HOTOBJECTCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Recently fetched encoded blobs kept in memory, keyed by (archive, eKey) with an empty archive
+// for loose files. Split into independently locked LRU shards so parallel extraction doesn't
+// serialize on one mutex. Blobs are shared, every reader of a hot object gets the same buffer.
+class HotObjectCache {
+public:
+    using Blob = std::shared_ptr<const std::vector<uint8_t>>;
+
+    // maxSize of 0 disables the cache
+    explicit HotObjectCache(size_t maxSize, size_t shardCount = 16);
+
+    HotObjectCache(const HotObjectCache&) = delete;
+    HotObjectCache& operator=(const HotObjectCache&) = delete;
+
+    // nullptr if the blob isn't held
+    Blob Find(const std::string& archive, const std::string& eKey);
+
+    // Blobs bigger than a quarter of a shard's budget are not kept, they would flush everything else
+    void Insert(const std::string& archive, const std::string& eKey, Blob blob);
+
+    void Clear();
+
+private:
+    struct Shard {
+        std::mutex mutex;
+        std::list<std::pair<std::string, Blob>> lru;  // most recently used first
+        std::unordered_map<std::string, std::list<std::pair<std::string, Blob>>::iterator> index;
+        size_t size = 0;
+    };
+
+    static std::string Key(const std::string& archive, const std::string& eKey);
+    Shard& ShardFor(const std::string& key);
+
+    size_t shardBudget_;
+    std::vector<Shard> shards_;
+};
+
+#endif //HOTOBJECTCACHE_H
@@ -0,0 +1,57 @@
+#include "HttpSessionPool.h"
+
+#include "cpr/cpr.h"
+
+HttpSessionPool::HttpSessionPool(size_t maxIdlePerServer)
+    : maxIdlePerServer_(maxIdlePerServer) {
+}
+
+HttpSessionPool::~HttpSessionPool() = default;
+
+HttpSessionPool::Lease::Lease(HttpSessionPool* pool, std::string server, std::unique_ptr<cpr::Session> session)
+    : pool_(pool), server_(std::move(server)), session_(std::move(session)) {
+}
+
+HttpSessionPool::Lease::Lease(Lease&& other) noexcept
+    : pool_(other.pool_),
+      server_(std::move(other.server_)),
+      session_(std::move(other.session_)),
+      discard_(other.discard_) {
+}
+
+HttpSessionPool::Lease::~Lease() {
+    if (session_ && !discard_)
+        pool_->Release(server_, std::move(session_));
+}
+
+HttpSessionPool::Lease HttpSessionPool::Acquire(const std::string& server) {
+    {
+        std::scoped_lock lock(mutex_);
+        auto it = idle_.find(server);
+        if (it != idle_.end() && !it->second.empty()) {
+            auto session = std::move(it->second.back());
+            it->second.pop_back();
+            return Lease(this, server, std::move(session));
+        }
+    }
+
+    return Lease(this, server, std::make_unique<cpr::Session>());
+}
+
+void HttpSessionPool::Clear() {
+    std::scoped_lock lock(mutex_);
+    idle_.clear();
+}
+
+size_t HttpSessionPool::IdleCount(const std::string& server) {
+    std::scoped_lock lock(mutex_);
+    auto it = idle_.find(server);
+    return it == idle_.end() ? 0 : it->second.size();
+}
+
+void HttpSessionPool::Release(const std::string& server, std::unique_ptr<cpr::Session> session) {
+    std::scoped_lock lock(mutex_);
+    auto& sessions = idle_[server];
+    if (sessions.size() < maxIdlePerServer_)
+        sessions.push_back(std::move(session));
+}
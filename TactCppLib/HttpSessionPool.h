@@ -0,0 +1,66 @@
+#ifndef HTTPSESSIONPOOL_H
+#define HTTPSESSIONPOOL_H
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cpr {
+    class Session;
+}
+
+// Idle cpr sessions kept per server, so consecutive requests to the same host reuse
+// the curl handle and its keep-alive connection instead of paying DNS + TCP setup again.
+class HttpSessionPool {
+public:
+    explicit HttpSessionPool(size_t maxIdlePerServer = 8);
+    ~HttpSessionPool();
+
+    HttpSessionPool(const HttpSessionPool&) = delete;
+    HttpSessionPool& operator=(const HttpSessionPool&) = delete;
+
+    // A checked-out session, handed back to the pool when it goes out of scope
+    class Lease {
+    public:
+        Lease(Lease&& other) noexcept;
+        Lease& operator=(Lease&&) = delete;
+        ~Lease();
+
+        cpr::Session& operator*() const { return *session_; }
+        cpr::Session* operator->() const { return session_.get(); }
+
+        // Drop the session instead of pooling it, e.g. after a transport error
+        void Discard() { discard_ = true; }
+
+    private:
+        friend class HttpSessionPool;
+        Lease(HttpSessionPool* pool, std::string server, std::unique_ptr<cpr::Session> session);
+
+        HttpSessionPool*              pool_;
+        std::string                   server_;
+        std::unique_ptr<cpr::Session> session_;
+        bool                          discard_ = false;
+    };
+
+    // Reuses an idle session for server if there is one, creates a new one otherwise.
+    // Callers must set every per-request option (URL, headers, timeout, callbacks) themselves.
+    Lease Acquire(const std::string& server);
+
+    // Close all idle sessions
+    void Clear();
+
+    // Idle sessions kept for server
+    size_t IdleCount(const std::string& server);
+
+private:
+    void Release(const std::string& server, std::unique_ptr<cpr::Session> session);
+
+    size_t maxIdlePerServer_;
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::vector<std::unique_ptr<cpr::Session>>> idle_;
+};
+
+#endif //HTTPSESSIONPOOL_H
@@ -0,0 +1,134 @@
+#include "LocalArchivePool.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <format>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+struct LocalArchivePool::Archive {
+    std::shared_ptr<MemoryMappedFile> mapping;  // null if the archive couldn't be mapped
+#ifdef _WIN32
+    HANDLE handle = INVALID_HANDLE_VALUE;
+#else
+    int    fd = -1;
+#endif
+
+    ~Archive() {
+#ifdef _WIN32
+        if (handle != INVALID_HANDLE_VALUE)
+            CloseHandle(handle);
+#else
+        if (fd >= 0)
+            ::close(fd);
+#endif
+    }
+
+    // Positional read, safe to call from several threads at once
+    bool ReadAt(uint64_t offset, uint8_t* out, size_t size) const {
+        while (size > 0) {
+#ifdef _WIN32
+            OVERLAPPED overlapped{};
+            overlapped.Offset     = static_cast<DWORD>(offset);
+            overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+            DWORD toRead = static_cast<DWORD>(std::min<size_t>(size, 1u << 30));
+            DWORD read = 0;
+            if (!ReadFile(handle, out, toRead, &read, &overlapped) || read == 0)
+                return false;
+#else
+            ssize_t read = ::pread(fd, out, size, static_cast<off_t>(offset));
+            if (read < 0 && errno == EINTR)
+                continue;
+            if (read <= 0)
+                return false;
+#endif
+            offset += read;
+            out += read;
+            size -= read;
+        }
+        return true;
+    }
+};
+
+LocalArchivePool::LocalArchivePool(std::filesystem::path dataDir)
+    : dataDir_(std::move(dataDir)) {
+}
+
+LocalArchivePool::~LocalArchivePool() = default;
+
+std::shared_ptr<LocalArchivePool::Archive> LocalArchivePool::Open(int archiveIndex) {
+    std::scoped_lock lock(mutex_);
+    if (auto it = archives_.find(archiveIndex); it != archives_.end())
+        return it->second;
+
+    auto path = dataDir_ / std::format("data.{:03}", archiveIndex);
+    auto archive = std::make_shared<Archive>();
+
+#ifdef _WIN32
+    // The client may have its archives open for writing, which a mapping opened for shared reading conflicts with
+    archive->handle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                  nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (archive->handle == INVALID_HANDLE_VALUE)
+        return nullptr;
+#else
+    archive->fd = ::open(path.c_str(), O_RDONLY);
+    if (archive->fd < 0)
+        return nullptr;
+#endif
+
+    // Archives are up to a few GB each, only map them where the address space allows
+    if constexpr (sizeof(void*) >= 8) {
+        try {
+            archive->mapping = std::make_shared<MemoryMappedFile>(path.string());
+        } catch (const std::exception& e) {
+            std::cerr << "Failed to map " << path.string() << ", reading it instead: " << e.what() << std::endl;
+        }
+    }
+
+    archives_.emplace(archiveIndex, archive);
+    return archive;
+}
+
+std::optional<LocalArchivePool::View> LocalArchivePool::Read(int archiveIndex, uint64_t offset, size_t size) {
+    auto archive = Open(archiveIndex);
+    if (!archive)
+        return std::nullopt;
+
+    if (archive->mapping && offset + size <= archive->mapping->size()) {
+        std::span<const uint8_t> bytes(static_cast<const uint8_t*>(archive->mapping->data()) + offset, size);
+        return View{archive->mapping, bytes};
+    }
+
+    // Not mapped, or appended to after it was mapped
+    auto buffer = std::make_shared<std::vector<uint8_t>>(size);
+    if (!archive->ReadAt(offset, buffer->data(), size))
+        return std::nullopt;
+
+    std::span<const uint8_t> bytes(buffer->data(), buffer->size());
+    return View{std::move(buffer), bytes};
+}
+
+std::optional<LocalArchivePool::View> LocalArchivePool::ReadEntry(int archiveIndex, uint64_t offset, size_t size,
+                                                                  std::span<const uint8_t> eKey) {
+    if (size < EntryHeaderSize)
+        throw std::runtime_error(std::format("Local entry at data.{:03}:{} is smaller than its header", archiveIndex, offset));
+
+    auto view = Read(archiveIndex, offset, size);
+    if (!view)
+        return std::nullopt;
+
+    // 1) The header repeats the key reversed, and the size the index has
+    const uint8_t* header = view->bytes.data();
+    bool keyMatches = true;
+    for (size_t i = 0; i < std::min<size_t>(eKey.size(), 16); ++i)
+        keyMatches &= header[15 - i] == eKey[i];
+
+    uint32_t recordSize = header[16] | (header[17] << 8) | (header[18] << 16) | (uint32_t(header[19]) << 24);
+    if (!keyMatches || recordSize != size)
+        throw std::runtime_error(std::format("Local entry at data.{:03}:{} doesn't match its index entry", archiveIndex, offset));
+
+    // 2) Only the blob after it is handed out
+    view->bytes = view->bytes.subspan(EntryHeaderSize);
+    return view;
+}
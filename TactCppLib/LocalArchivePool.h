@@ -0,0 +1,55 @@
+#ifndef LOCALARCHIVEPOOL_H
+#define LOCALARCHIVEPOOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <unordered_map>
+
+#include "MemoryMappedFile.h"
+
+// The data.NNN archives of a local install, opened on first use and shared by all threads.
+// Archives are mapped and reads are views into the mapping. Where mapping isn't possible
+// (32-bit address space, a failed map) or a read lies past the mapped size because the client
+// appended to the archive since, bytes are read with a positional read instead.
+class LocalArchivePool {
+public:
+    // Bytes of one read, valid as long as owner is held
+    struct View {
+        std::shared_ptr<const void> owner;
+        std::span<const uint8_t>    bytes;
+    };
+
+    explicit LocalArchivePool(std::filesystem::path dataDir);
+    ~LocalArchivePool();
+
+    LocalArchivePool(const LocalArchivePool&) = delete;
+    LocalArchivePool& operator=(const LocalArchivePool&) = delete;
+
+    // Every record in an archive starts with this header: the eKey in reverse byte order, the
+    // record size (header included) as LE uint32, 2 flag bytes and two 4 byte checksums
+    static constexpr size_t EntryHeaderSize = 0x1E;
+
+    // size bytes at offset of data.<archiveIndex>, empty if the archive is missing or too short
+    std::optional<View> Read(int archiveIndex, uint64_t offset, size_t size);
+
+    // The BLTE blob of the record at offset, as the local index describes it. Throws if the
+    // record's header names another eKey or size.
+    std::optional<View> ReadEntry(int archiveIndex, uint64_t offset, size_t size, std::span<const uint8_t> eKey);
+
+private:
+    struct Archive;
+
+    std::shared_ptr<Archive> Open(int archiveIndex);
+
+    std::filesystem::path dataDir_;
+
+    std::mutex mutex_;
+    std::unordered_map<int, std::shared_ptr<Archive>> archives_;
+};
+
+#endif //LOCALARCHIVEPOOL_H
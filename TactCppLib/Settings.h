@@ -19,6 +19,20 @@ struct Settings {
     std::optional<std::string> BuildConfig;
     std::optional<std::string> CDNConfig;
     std::filesystem::path CacheDir = "cache";
+    std::optional<std::filesystem::path> MirrorDir;  // local copy of the CDN, <MirrorDir>/<productDir>/<type>/ab/cd/<hash>
+    bool        VerifyChecksums  = false;   // check BLTE chunk MD5s when decoding
+    bool        MergeLocalIndices = false;  // copy the local .idx buckets into one sorted in-memory table
+    size_t      MaxIdleConnectionsPerServer = 8;   // keep-alive CDN sessions kept per server
+    size_t      RangeCoalesceGap     = 64 * 1024;         // archive ranges closer than this share a request
+    size_t      MaxCoalescedRangeSize = 16 * 1024 * 1024; // upper bound for one merged request
+    bool        HedgeRequests    = false;   // race the next CDN host when one is slower than its p95
+    size_t      MaxConcurrentDownloads          = 16;  // requests on the wire across all CDN hosts
+    size_t      MaxConcurrentDownloadsPerServer = 4;
+    size_t      HotObjectCacheSize = 64 * 1024 * 1024;  // recently fetched encoded blobs kept in memory, 0 = off
+    double      WholeArchiveThreshold = 0.5;  // fetch an archive whole once ranges cost this fraction of it, 0 = never
+    size_t      WholeArchiveMinRanges = 32;   // ranges asked from an archive before its size is looked up
+    uint64_t    WholeArchiveRequestCost = 64 * 1024;  // bytes one extra request is worth in latency
+    uint64_t    MaxCacheSize     = 0;       // bytes kept in CacheDir before least recently used files go, 0 = unbounded
     bool        ListfileFallback = true;
     std::string ListfileURL   = "https://github.com/wowdev/wow-listfile/releases/latest/download/community-listfile.csv";
 };
@@ -0,0 +1,59 @@
+#ifndef SINGLEFLIGHT_H
+#define SINGLEFLIGHT_H
+
+#include <exception>
+#include <future>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Collapses concurrent calls for the same key into one: the first caller runs the work, everyone
+// arriving while it runs waits for it and gets the same result, or the same exception.
+// Nothing is remembered once a call finished, caching is up to the work itself.
+template<typename T>
+class SingleFlight {
+public:
+    template<typename Fn>
+    T Do(const std::string& key, Fn&& fn) {
+        std::promise<T> promise;
+        std::shared_future<T> running;
+        {
+            std::scoped_lock lock(mutex_);
+            auto [it, inserted] = calls_.try_emplace(key);
+            if (inserted)
+                it->second = promise.get_future().share();
+            else
+                running = it->second;
+        }
+
+        if (running.valid())
+            return running.get();
+
+        try {
+            T result = fn();
+            Finish(key);
+            promise.set_value(result);
+            return result;
+        } catch (...) {
+            Finish(key);
+            promise.set_exception(std::current_exception());
+            throw;
+        }
+    }
+
+    size_t InFlight() const {
+        std::scoped_lock lock(mutex_);
+        return calls_.size();
+    }
+
+private:
+    void Finish(const std::string& key) {
+        std::scoped_lock lock(mutex_);
+        calls_.erase(key);
+    }
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, std::shared_future<T>> calls_;
+};
+
+#endif //SINGLEFLIGHT_H
@@ -0,0 +1,83 @@
+#include "Inflate.h"
+
+#include <stdexcept>
+
+#ifdef TACT_INFLATE_LIBDEFLATE
+#include <libdeflate.h>
+#else
+#include <zlib.h>
+#endif
+
+#ifdef TACT_INFLATE_LIBDEFLATE
+
+namespace {
+    struct Decompressor {
+        libdeflate_decompressor* handle = libdeflate_alloc_decompressor();
+
+        Decompressor() {
+            if (!handle)
+                throw std::runtime_error("Failed to allocate libdeflate decompressor");
+        }
+        ~Decompressor() {
+            libdeflate_free_decompressor(handle);
+        }
+
+        static libdeflate_decompressor* ForThread() {
+            thread_local Decompressor decompressor;
+            return decompressor.handle;
+        }
+    };
+}
+
+bool Inflate::Decompress(const uint8_t* in, size_t inSize, uint8_t* out, size_t outSize) {
+    size_t actualSize = 0;
+    auto result = libdeflate_zlib_decompress(Decompressor::ForThread(), in, inSize, out, outSize, &actualSize);
+    return result == LIBDEFLATE_SUCCESS && actualSize == outSize;
+}
+
+const char* Inflate::BackendName() {
+    return "libdeflate";
+}
+
+#else
+
+namespace {
+    // Inflate state reused by every chunk decoded on this thread
+    struct InflateContext {
+        z_stream stream{};
+
+        InflateContext() {
+            if (inflateInit(&stream) != Z_OK)
+                throw std::runtime_error("Failed to init zlib inflate");
+        }
+        ~InflateContext() {
+            inflateEnd(&stream);
+        }
+
+        static InflateContext& ForThread() {
+            thread_local InflateContext context;
+            return context;
+        }
+    };
+}
+
+bool Inflate::Decompress(const uint8_t* in, size_t inSize, uint8_t* out, size_t outSize) {
+    // inflateReset keeps the ~7 KB window allocated across chunks
+    z_stream& stream = InflateContext::ForThread().stream;
+    if (inflateReset(&stream) != Z_OK)
+        throw std::runtime_error("Failed to reset zlib inflate");
+
+    stream.next_in   = const_cast<Bytef*>(in);
+    stream.avail_in  = static_cast<uInt>(inSize);
+    stream.next_out  = out;
+    stream.avail_out = static_cast<uInt>(outSize);
+
+    // Same contract as libdeflate, a stream ending short of outSize is an error
+    return inflate(&stream, Z_FINISH) == Z_STREAM_END && stream.avail_out == 0;
+}
+
+const char* Inflate::BackendName() {
+    return "zlib";
+}
+
+#endif
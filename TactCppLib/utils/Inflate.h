@@ -0,0 +1,21 @@
+#ifndef INFLATE_H
+#define INFLATE_H
+
+#include <cstdint>
+#include <cstddef>
+
+// One-shot zlib inflate for BLTE 'Z' chunks. The decompressed size of a chunk
+// is always known, so backends can decode whole buffers without streaming.
+// The backend is picked at build time with TACT_INFLATE_BACKEND.
+class Inflate {
+public:
+    // Returns false if the stream is corrupt or doesn't decode to exactly outSize bytes
+    static bool Decompress(const uint8_t* in, size_t inSize, uint8_t* out, size_t outSize);
+
+    static const char* BackendName();
+
+private:
+    Inflate() = delete;
+};
+
+#endif //INFLATE_H
@@ -6,6 +6,8 @@
 #include <iomanip>
 #include <filesystem>
 
+#include "Salsa20.h"
+
 // Static member definitions
 std::unordered_map<uint64_t, std::vector<uint8_t>> KeyService::keys_;
 bool KeyService::initialized_ = KeyService::Initialize();
@@ -24,6 +26,19 @@ bool KeyService::TryGetKey(uint64_t keyName, std::vector<uint8_t>& outKey) {
     return true;
 }
 
+bool KeyService::TryGetKey(uint64_t keyName, std::span<const uint8_t>& outKey) {
+    auto it = KeyService::keys_.find(keyName);
+    if (it == KeyService::keys_.end())
+        return false;
+    outKey = it->second;
+    return true;
+}
+
+Salsa20& KeyService::SalsaInstance() {
+    static Salsa20 instance;
+    return instance;
+}
+
 void KeyService::SetKey(uint64_t keyName, const std::vector<uint8_t>& key) {
     KeyService::keys_[keyName] = key;
 }
@@ -5,6 +5,7 @@
 #include <vector>
 #include <unordered_map>
 #include <optional>
+#include <span>
 #include <string>
 
 class Salsa20;  // forward‑declare your Salsa20 implementation
@@ -16,6 +17,8 @@ public:
 
     // Try to get a key; returns true if found
     static bool TryGetKey(uint64_t keyName, std::vector<uint8_t>& outKey);
+    // Same, without copying the key
+    static bool TryGetKey(uint64_t keyName, std::span<const uint8_t>& outKey);
 
     // Insert or overwrite a key
     static void SetKey(uint64_t keyName, const std::vector<uint8_t>& key);
@@ -0,0 +1,169 @@
+#include "MD5.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    inline uint32_t RotL(uint32_t x, int c) {
+        return (x << c) | (x >> (32 - c));
+    }
+
+    // Round functions in the forms that compile to the fewest instructions
+    #define MD5_FUNC_F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+    #define MD5_FUNC_G(x, y, z) ((y) ^ ((z) & ((x) ^ (y))))
+    #define MD5_FUNC_H(x, y, z) ((x) ^ (y) ^ (z))
+    #define MD5_FUNC_I(x, y, z) ((y) ^ ((x) | ~(z)))
+
+    #define MD5_STEP(f, a, b, c, d, w, k, s) \
+        a += f(b, c, d) + (w) + (k);          \
+        a = RotL(a, s) + b;
+}
+
+MD5::MD5()
+    : state_{0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476} {
+}
+
+void MD5::ProcessBlocks(const uint8_t* data, size_t blocks) {
+    uint32_t a0 = state_[0], b0 = state_[1], c0 = state_[2], d0 = state_[3];
+
+    for (; blocks > 0; --blocks, data += 64) {
+        // Message words are little-endian, same as every platform we build for
+        uint32_t w[16];
+        std::memcpy(w, data, 64);
+
+        uint32_t a = a0, b = b0, c = c0, d = d0;
+
+        MD5_STEP(MD5_FUNC_F, a, b, c, d, w[ 0], 0xd76aa478,  7)
+        MD5_STEP(MD5_FUNC_F, d, a, b, c, w[ 1], 0xe8c7b756, 12)
+        MD5_STEP(MD5_FUNC_F, c, d, a, b, w[ 2], 0x242070db, 17)
+        MD5_STEP(MD5_FUNC_F, b, c, d, a, w[ 3], 0xc1bdceee, 22)
+        MD5_STEP(MD5_FUNC_F, a, b, c, d, w[ 4], 0xf57c0faf,  7)
+        MD5_STEP(MD5_FUNC_F, d, a, b, c, w[ 5], 0x4787c62a, 12)
+        MD5_STEP(MD5_FUNC_F, c, d, a, b, w[ 6], 0xa8304613, 17)
+        MD5_STEP(MD5_FUNC_F, b, c, d, a, w[ 7], 0xfd469501, 22)
+        MD5_STEP(MD5_FUNC_F, a, b, c, d, w[ 8], 0x698098d8,  7)
+        MD5_STEP(MD5_FUNC_F, d, a, b, c, w[ 9], 0x8b44f7af, 12)
+        MD5_STEP(MD5_FUNC_F, c, d, a, b, w[10], 0xffff5bb1, 17)
+        MD5_STEP(MD5_FUNC_F, b, c, d, a, w[11], 0x895cd7be, 22)
+        MD5_STEP(MD5_FUNC_F, a, b, c, d, w[12], 0x6b901122,  7)
+        MD5_STEP(MD5_FUNC_F, d, a, b, c, w[13], 0xfd987193, 12)
+        MD5_STEP(MD5_FUNC_F, c, d, a, b, w[14], 0xa679438e, 17)
+        MD5_STEP(MD5_FUNC_F, b, c, d, a, w[15], 0x49b40821, 22)
+
+        MD5_STEP(MD5_FUNC_G, a, b, c, d, w[ 1], 0xf61e2562,  5)
+        MD5_STEP(MD5_FUNC_G, d, a, b, c, w[ 6], 0xc040b340,  9)
+        MD5_STEP(MD5_FUNC_G, c, d, a, b, w[11], 0x265e5a51, 14)
+        MD5_STEP(MD5_FUNC_G, b, c, d, a, w[ 0], 0xe9b6c7aa, 20)
+        MD5_STEP(MD5_FUNC_G, a, b, c, d, w[ 5], 0xd62f105d,  5)
+        MD5_STEP(MD5_FUNC_G, d, a, b, c, w[10], 0x02441453,  9)
+        MD5_STEP(MD5_FUNC_G, c, d, a, b, w[15], 0xd8a1e681, 14)
+        MD5_STEP(MD5_FUNC_G, b, c, d, a, w[ 4], 0xe7d3fbc8, 20)
+        MD5_STEP(MD5_FUNC_G, a, b, c, d, w[ 9], 0x21e1cde6,  5)
+        MD5_STEP(MD5_FUNC_G, d, a, b, c, w[14], 0xc33707d6,  9)
+        MD5_STEP(MD5_FUNC_G, c, d, a, b, w[ 3], 0xf4d50d87, 14)
+        MD5_STEP(MD5_FUNC_G, b, c, d, a, w[ 8], 0x455a14ed, 20)
+        MD5_STEP(MD5_FUNC_G, a, b, c, d, w[13], 0xa9e3e905,  5)
+        MD5_STEP(MD5_FUNC_G, d, a, b, c, w[ 2], 0xfcefa3f8,  9)
+        MD5_STEP(MD5_FUNC_G, c, d, a, b, w[ 7], 0x676f02d9, 14)
+        MD5_STEP(MD5_FUNC_G, b, c, d, a, w[12], 0x8d2a4c8a, 20)
+
+        MD5_STEP(MD5_FUNC_H, a, b, c, d, w[ 5], 0xfffa3942,  4)
+        MD5_STEP(MD5_FUNC_H, d, a, b, c, w[ 8], 0x8771f681, 11)
+        MD5_STEP(MD5_FUNC_H, c, d, a, b, w[11], 0x6d9d6122, 16)
+        MD5_STEP(MD5_FUNC_H, b, c, d, a, w[14], 0xfde5380c, 23)
+        MD5_STEP(MD5_FUNC_H, a, b, c, d, w[ 1], 0xa4beea44,  4)
+        MD5_STEP(MD5_FUNC_H, d, a, b, c, w[ 4], 0x4bdecfa9, 11)
+        MD5_STEP(MD5_FUNC_H, c, d, a, b, w[ 7], 0xf6bb4b60, 16)
+        MD5_STEP(MD5_FUNC_H, b, c, d, a, w[10], 0xbebfbc70, 23)
+        MD5_STEP(MD5_FUNC_H, a, b, c, d, w[13], 0x289b7ec6,  4)
+        MD5_STEP(MD5_FUNC_H, d, a, b, c, w[ 0], 0xeaa127fa, 11)
+        MD5_STEP(MD5_FUNC_H, c, d, a, b, w[ 3], 0xd4ef3085, 16)
+        MD5_STEP(MD5_FUNC_H, b, c, d, a, w[ 6], 0x04881d05, 23)
+        MD5_STEP(MD5_FUNC_H, a, b, c, d, w[ 9], 0xd9d4d039,  4)
+        MD5_STEP(MD5_FUNC_H, d, a, b, c, w[12], 0xe6db99e5, 11)
+        MD5_STEP(MD5_FUNC_H, c, d, a, b, w[15], 0x1fa27cf8, 16)
+        MD5_STEP(MD5_FUNC_H, b, c, d, a, w[ 2], 0xc4ac5665, 23)
+
+        MD5_STEP(MD5_FUNC_I, a, b, c, d, w[ 0], 0xf4292244,  6)
+        MD5_STEP(MD5_FUNC_I, d, a, b, c, w[ 7], 0x432aff97, 10)
+        MD5_STEP(MD5_FUNC_I, c, d, a, b, w[14], 0xab9423a7, 15)
+        MD5_STEP(MD5_FUNC_I, b, c, d, a, w[ 5], 0xfc93a039, 21)
+        MD5_STEP(MD5_FUNC_I, a, b, c, d, w[12], 0x655b59c3,  6)
+        MD5_STEP(MD5_FUNC_I, d, a, b, c, w[ 3], 0x8f0ccc92, 10)
+        MD5_STEP(MD5_FUNC_I, c, d, a, b, w[10], 0xffeff47d, 15)
+        MD5_STEP(MD5_FUNC_I, b, c, d, a, w[ 1], 0x85845dd1, 21)
+        MD5_STEP(MD5_FUNC_I, a, b, c, d, w[ 8], 0x6fa87e4f,  6)
+        MD5_STEP(MD5_FUNC_I, d, a, b, c, w[15], 0xfe2ce6e0, 10)
+        MD5_STEP(MD5_FUNC_I, c, d, a, b, w[ 6], 0xa3014314, 15)
+        MD5_STEP(MD5_FUNC_I, b, c, d, a, w[13], 0x4e0811a1, 21)
+        MD5_STEP(MD5_FUNC_I, a, b, c, d, w[ 4], 0xf7537e82,  6)
+        MD5_STEP(MD5_FUNC_I, d, a, b, c, w[11], 0xbd3af235, 10)
+        MD5_STEP(MD5_FUNC_I, c, d, a, b, w[ 2], 0x2ad7d2bb, 15)
+        MD5_STEP(MD5_FUNC_I, b, c, d, a, w[ 9], 0xeb86d391, 21)
+
+        a0 += a;
+        b0 += b;
+        c0 += c;
+        d0 += d;
+    }
+
+    state_[0] = a0;
+    state_[1] = b0;
+    state_[2] = c0;
+    state_[3] = d0;
+}
+
+void MD5::Update(const uint8_t* data, size_t size) {
+    length_ += size;
+
+    // 1) top up a partially filled block
+    if (bufferSize_ > 0) {
+        size_t take = std::min(size, sizeof(buffer_) - bufferSize_);
+        std::memcpy(buffer_ + bufferSize_, data, take);
+        bufferSize_ += take;
+        data += take;
+        size -= take;
+
+        if (bufferSize_ < sizeof(buffer_))
+            return;
+        ProcessBlocks(buffer_, 1);
+        bufferSize_ = 0;
+    }
+
+    // 2) whole blocks straight from the input
+    size_t blocks = size / 64;
+    if (blocks > 0) {
+        ProcessBlocks(data, blocks);
+        data += blocks * 64;
+        size -= blocks * 64;
+    }
+
+    // 3) keep the tail for later
+    if (size > 0) {
+        std::memcpy(buffer_, data, size);
+        bufferSize_ = size;
+    }
+}
+
+MD5::Digest MD5::Final() {
+    uint64_t bitLength = length_ * 8;
+
+    // Pad with 0x80 and zeros up to 56 mod 64, then the bit length
+    uint8_t padding[72] = {0x80};
+    size_t padSize = (bufferSize_ < 56 ? 56 : 120) - bufferSize_;
+    Update(padding, padSize);
+
+    uint8_t lengthBytes[8];
+    std::memcpy(lengthBytes, &bitLength, 8);
+    Update(lengthBytes, 8);
+
+    Digest digest;
+    std::memcpy(digest.data(), state_, digest.size());
+    return digest;
+}
+
+MD5::Digest MD5::Compute(const uint8_t* data, size_t size) {
+    MD5 md5;
+    md5.Update(data, size);
+    return md5.Final();
+}
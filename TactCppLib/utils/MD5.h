@@ -0,0 +1,30 @@
+#ifndef MD5_H
+#define MD5_H
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+// MD5 used for BLTE chunk checksums, eKeys and index footers. Whole 64 byte blocks
+// are hashed straight from the caller's buffer with a fully unrolled round function.
+class MD5 {
+public:
+    using Digest = std::array<uint8_t, 16>;
+
+    MD5();
+
+    void   Update(const uint8_t* data, size_t size);
+    Digest Final();
+
+    static Digest Compute(const uint8_t* data, size_t size);
+
+private:
+    void ProcessBlocks(const uint8_t* data, size_t blocks);
+
+    uint32_t state_[4];
+    uint64_t length_ = 0;
+    uint8_t  buffer_[64];
+    size_t   bufferSize_ = 0;
+};
+
+#endif //MD5_H
@@ -0,0 +1,305 @@
+#include "Salsa20.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define SALSA20_SSE2 1
+  #include <emmintrin.h>
+#endif
+
+// AVX2 is compiled in with a target attribute and picked at runtime on GCC/Clang,
+// MSVC only gets it when the whole build targets AVX2.
+#if defined(SALSA20_SSE2) && (defined(__GNUC__) || defined(__clang__))
+  #define SALSA20_AVX2 1
+  #define SALSA20_AVX2_TARGET __attribute__((target("avx2")))
+  #include <immintrin.h>
+#elif defined(SALSA20_SSE2) && defined(__AVX2__)
+  #define SALSA20_AVX2 1
+  #define SALSA20_AVX2_TARGET
+  #include <immintrin.h>
+#endif
+
+#define SALSA20_QUARTER(a, b, c, d, ADD, XOR, ROTL) \
+    b = XOR(b, ROTL(ADD(a, d), 7));                 \
+    c = XOR(c, ROTL(ADD(b, a), 9));                 \
+    d = XOR(d, ROTL(ADD(c, b), 13));                \
+    a = XOR(a, ROTL(ADD(d, c), 18));
+
+#define SALSA20_DOUBLE_ROUND(x, ADD, XOR, ROTL)                        \
+    SALSA20_QUARTER(x[0],  x[4],  x[8],  x[12], ADD, XOR, ROTL)        \
+    SALSA20_QUARTER(x[5],  x[9],  x[13], x[1],  ADD, XOR, ROTL)        \
+    SALSA20_QUARTER(x[10], x[14], x[2],  x[6],  ADD, XOR, ROTL)        \
+    SALSA20_QUARTER(x[15], x[3],  x[7],  x[11], ADD, XOR, ROTL)        \
+    SALSA20_QUARTER(x[0],  x[1],  x[2],  x[3],  ADD, XOR, ROTL)        \
+    SALSA20_QUARTER(x[5],  x[6],  x[7],  x[4],  ADD, XOR, ROTL)        \
+    SALSA20_QUARTER(x[10], x[11], x[8],  x[9],  ADD, XOR, ROTL)        \
+    SALSA20_QUARTER(x[15], x[12], x[13], x[14], ADD, XOR, ROTL)
+
+namespace {
+    constexpr int blockSize = 64;
+
+    inline uint32_t Load32LE(const uint8_t* p) {
+        return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+    }
+
+    inline uint64_t Counter(const uint32_t state[16]) {
+        return uint64_t(state[8]) | (uint64_t(state[9]) << 32);
+    }
+
+    inline void SetCounter(uint32_t state[16], uint64_t counter) {
+        state[8] = static_cast<uint32_t>(counter);
+        state[9] = static_cast<uint32_t>(counter >> 32);
+    }
+
+    // ---- scalar ----
+
+    inline uint32_t Add32(uint32_t a, uint32_t b) { return a + b; }
+    inline uint32_t Xor32(uint32_t a, uint32_t b) { return a ^ b; }
+    inline uint32_t Rotl32(uint32_t v, int c) { return (v << c) | (v >> (32 - c)); }
+
+    void KeystreamBlock(const uint32_t state[16], uint8_t keystream[blockSize]) {
+        uint32_t x[16];
+        for (int i = 0; i < 16; ++i)
+            x[i] = state[i];
+
+        for (int i = 0; i < 10; ++i) {
+            SALSA20_DOUBLE_ROUND(x, Add32, Xor32, Rotl32)
+        }
+
+        for (int i = 0; i < 16; ++i) {
+            uint32_t v = x[i] + state[i];
+            keystream[i * 4 + 0] = static_cast<uint8_t>(v);
+            keystream[i * 4 + 1] = static_cast<uint8_t>(v >> 8);
+            keystream[i * 4 + 2] = static_cast<uint8_t>(v >> 16);
+            keystream[i * 4 + 3] = static_cast<uint8_t>(v >> 24);
+        }
+    }
+
+#ifdef SALSA20_SSE2
+    // ---- SSE2: 4 blocks, one block per 32 bit lane ----
+
+    inline __m128i Add128(__m128i a, __m128i b) { return _mm_add_epi32(a, b); }
+    inline __m128i Xor128(__m128i a, __m128i b) { return _mm_xor_si128(a, b); }
+    inline __m128i Rotl128(__m128i v, int c) {
+        return _mm_or_si128(_mm_slli_epi32(v, c), _mm_srli_epi32(v, 32 - c));
+    }
+
+    // Rows r0..r3 hold word i..i+3 of lanes 0..3, turn them into words i..i+3 of each lane
+    inline void Transpose4(__m128i& r0, __m128i& r1, __m128i& r2, __m128i& r3) {
+        __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+        __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+        __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+        __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+        r0 = _mm_unpacklo_epi64(t0, t1);
+        r1 = _mm_unpackhi_epi64(t0, t1);
+        r2 = _mm_unpacklo_epi64(t2, t3);
+        r3 = _mm_unpackhi_epi64(t2, t3);
+    }
+
+    size_t XorBlocksSSE2(uint32_t state[16], const uint8_t* in, uint8_t* out, size_t blocks) {
+        constexpr size_t lanes = 4;
+        size_t done = 0;
+
+        for (; done + lanes <= blocks; done += lanes) {
+            uint64_t counter = Counter(state);
+
+            __m128i input[16];
+            for (int i = 0; i < 16; ++i)
+                input[i] = _mm_set1_epi32(static_cast<int>(state[i]));
+            input[8] = _mm_setr_epi32(int(uint32_t(counter)), int(uint32_t(counter + 1)),
+                                      int(uint32_t(counter + 2)), int(uint32_t(counter + 3)));
+            input[9] = _mm_setr_epi32(int(uint32_t(counter >> 32)), int(uint32_t((counter + 1) >> 32)),
+                                      int(uint32_t((counter + 2) >> 32)), int(uint32_t((counter + 3) >> 32)));
+
+            __m128i x[16];
+            for (int i = 0; i < 16; ++i)
+                x[i] = input[i];
+
+            for (int i = 0; i < 10; ++i) {
+                SALSA20_DOUBLE_ROUND(x, Add128, Xor128, Rotl128)
+            }
+
+            for (int i = 0; i < 16; ++i)
+                x[i] = _mm_add_epi32(x[i], input[i]);
+
+            const uint8_t* src = in + done * blockSize;
+            uint8_t* dst = out + done * blockSize;
+            for (int group = 0; group < 4; ++group) {
+                __m128i r0 = x[group * 4], r1 = x[group * 4 + 1], r2 = x[group * 4 + 2], r3 = x[group * 4 + 3];
+                Transpose4(r0, r1, r2, r3);
+
+                const __m128i rows[4] = {r0, r1, r2, r3};
+                for (size_t lane = 0; lane < lanes; ++lane) {
+                    size_t pos = lane * blockSize + group * 16;
+                    __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + pos));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + pos), _mm_xor_si128(data, rows[lane]));
+                }
+            }
+
+            SetCounter(state, counter + lanes);
+        }
+
+        return done;
+    }
+#endif
+
+#ifdef SALSA20_AVX2
+    // ---- AVX2: 8 blocks, lanes 0-3 in the low and 4-7 in the high 128 bit half ----
+
+    SALSA20_AVX2_TARGET inline __m256i Add256(__m256i a, __m256i b) { return _mm256_add_epi32(a, b); }
+    SALSA20_AVX2_TARGET inline __m256i Xor256(__m256i a, __m256i b) { return _mm256_xor_si256(a, b); }
+    SALSA20_AVX2_TARGET inline __m256i Rotl256(__m256i v, int c) {
+        return _mm256_or_si256(_mm256_slli_epi32(v, c), _mm256_srli_epi32(v, 32 - c));
+    }
+
+    SALSA20_AVX2_TARGET size_t XorBlocksAVX2(uint32_t state[16], const uint8_t* in, uint8_t* out, size_t blocks) {
+        constexpr size_t lanes = 8;
+        size_t done = 0;
+
+        for (; done + lanes <= blocks; done += lanes) {
+            uint64_t counter = Counter(state);
+
+            __m256i input[16];
+            for (int i = 0; i < 16; ++i)
+                input[i] = _mm256_set1_epi32(static_cast<int>(state[i]));
+
+            alignas(32) uint32_t lo[lanes], hi[lanes];
+            for (size_t lane = 0; lane < lanes; ++lane) {
+                lo[lane] = static_cast<uint32_t>(counter + lane);
+                hi[lane] = static_cast<uint32_t>((counter + lane) >> 32);
+            }
+            input[8] = _mm256_load_si256(reinterpret_cast<const __m256i*>(lo));
+            input[9] = _mm256_load_si256(reinterpret_cast<const __m256i*>(hi));
+
+            __m256i x[16];
+            for (int i = 0; i < 16; ++i)
+                x[i] = input[i];
+
+            for (int i = 0; i < 10; ++i) {
+                SALSA20_DOUBLE_ROUND(x, Add256, Xor256, Rotl256)
+            }
+
+            for (int i = 0; i < 16; ++i)
+                x[i] = _mm256_add_epi32(x[i], input[i]);
+
+            const uint8_t* src = in + done * blockSize;
+            uint8_t* dst = out + done * blockSize;
+            for (int group = 0; group < 4; ++group) {
+                __m256i r0 = x[group * 4], r1 = x[group * 4 + 1], r2 = x[group * 4 + 2], r3 = x[group * 4 + 3];
+
+                // 4x4 transpose inside each 128 bit half
+                __m256i t0 = _mm256_unpacklo_epi32(r0, r1);
+                __m256i t1 = _mm256_unpacklo_epi32(r2, r3);
+                __m256i t2 = _mm256_unpackhi_epi32(r0, r1);
+                __m256i t3 = _mm256_unpackhi_epi32(r2, r3);
+                const __m256i rows[4] = {
+                    _mm256_unpacklo_epi64(t0, t1), _mm256_unpackhi_epi64(t0, t1),
+                    _mm256_unpacklo_epi64(t2, t3), _mm256_unpackhi_epi64(t2, t3)
+                };
+
+                for (size_t lane = 0; lane < 4; ++lane) {
+                    size_t posLow  = lane * blockSize + group * 16;
+                    size_t posHigh = (lane + 4) * blockSize + group * 16;
+
+                    __m128i low  = _mm256_castsi256_si128(rows[lane]);
+                    __m128i high = _mm256_extracti128_si256(rows[lane], 1);
+
+                    __m128i dataLow  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + posLow));
+                    __m128i dataHigh = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + posHigh));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + posLow), _mm_xor_si128(dataLow, low));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + posHigh), _mm_xor_si128(dataHigh, high));
+                }
+            }
+
+            SetCounter(state, counter + lanes);
+        }
+
+        return done;
+    }
+
+    bool CpuHasAVX2() {
+    #if defined(__GNUC__) || defined(__clang__)
+        return __builtin_cpu_supports("avx2");
+    #else
+        return true; // built with /arch:AVX2
+    #endif
+    }
+#endif
+}
+
+Salsa20::Salsa20() {
+#ifdef SALSA20_AVX2
+    if (CpuHasAVX2()) {
+        wideKernel_ = XorBlocksAVX2;
+        kernelName_ = "avx2";
+        return;
+    }
+#endif
+#ifdef SALSA20_SSE2
+    wideKernel_ = XorBlocksSSE2;
+    kernelName_ = "sse2";
+#endif
+}
+
+const char* Salsa20::KernelName() const {
+    return kernelName_;
+}
+
+void Salsa20::Decrypt(std::span<const uint8_t> key, std::span<const uint8_t, 8> iv,
+                      const uint8_t* in, size_t size, uint8_t* out,
+                      uint64_t streamOffset) const {
+    // "expand 32-byte k" / "expand 16-byte k"
+    static constexpr uint32_t sigma[4] = {0x61707865, 0x3320646e, 0x79622d32, 0x6b206574};
+    static constexpr uint32_t tau[4]   = {0x61707865, 0x3120646e, 0x79622d36, 0x6b206574};
+
+    if (key.size() != 16 && key.size() != 32)
+        throw std::runtime_error("Salsa20 key must be 16 or 32 bytes");
+
+    const uint32_t* constants = key.size() == 32 ? sigma : tau;
+    const uint8_t* key2 = key.size() == 32 ? key.data() + 16 : key.data();
+
+    uint32_t state[16] = {
+        constants[0],             Load32LE(key.data()),     Load32LE(key.data() + 4), Load32LE(key.data() + 8),
+        Load32LE(key.data() + 12), constants[1],            Load32LE(iv.data()),      Load32LE(iv.data() + 4),
+        0,                        0,                        constants[2],             Load32LE(key2),
+        Load32LE(key2 + 4),       Load32LE(key2 + 8),       Load32LE(key2 + 12),      constants[3]
+    };
+    SetCounter(state, streamOffset / blockSize);
+
+    uint8_t keystream[blockSize];
+
+    // Partial block at the start when resuming mid-stream
+    size_t skip = static_cast<size_t>(streamOffset % blockSize);
+    if (skip != 0 && size > 0) {
+        KeystreamBlock(state, keystream);
+        SetCounter(state, Counter(state) + 1);
+
+        size_t n = std::min<size_t>(size, blockSize - skip);
+        for (size_t i = 0; i < n; ++i)
+            out[i] = in[i] ^ keystream[skip + i];
+        in += n; out += n; size -= n;
+    }
+
+    size_t blocks = size / blockSize;
+    size_t done = 0;
+    if (wideKernel_)
+        done += wideKernel_(state, in, out, blocks);
+#ifdef SALSA20_SSE2
+    if (wideKernel_ != XorBlocksSSE2)
+        done += XorBlocksSSE2(state, in + done * blockSize, out + done * blockSize, blocks - done);
+#endif
+
+    in += done * blockSize; out += done * blockSize; size -= done * blockSize;
+
+    // Remaining whole blocks and the tail
+    while (size > 0) {
+        KeystreamBlock(state, keystream);
+        SetCounter(state, Counter(state) + 1);
+
+        size_t n = std::min<size_t>(size, blockSize);
+        for (size_t i = 0; i < n; ++i)
+            out[i] = in[i] ^ keystream[i];
+        in += n; out += n; size -= n;
+    }
+}
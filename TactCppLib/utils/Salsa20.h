@@ -0,0 +1,32 @@
+#ifndef SALSA20_H
+#define SALSA20_H
+
+#include <cstdint>
+#include <cstddef>
+#include <span>
+
+// Salsa20/20 stream cipher as used by TACT 'E' chunks (16 byte keys, 8 byte IVs).
+// Keystream blocks are generated 8 (AVX2) or 4 (SSE2) at a time when the CPU allows it.
+class Salsa20 {
+public:
+    Salsa20();
+
+    // XOR the keystream of (key, iv) into size bytes, starting streamOffset bytes into
+    // the stream. Encryption and decryption are the same operation; in may equal out.
+    void Decrypt(std::span<const uint8_t> key, std::span<const uint8_t, 8> iv,
+                 const uint8_t* in, size_t size, uint8_t* out,
+                 uint64_t streamOffset = 0) const;
+
+    // Widest keystream kernel picked for this CPU: "avx2", "sse2" or "scalar"
+    const char* KernelName() const;
+
+    // Processes as many whole 64 byte blocks as the kernel handles at once, advancing the
+    // block counter in state. Returns the number of blocks processed.
+    using BlockKernel = size_t (*)(uint32_t state[16], const uint8_t* in, uint8_t* out, size_t blocks);
+
+private:
+    BlockKernel wideKernel_ = nullptr;
+    const char* kernelName_ = "scalar";
+};
+
+#endif //SALSA20_H
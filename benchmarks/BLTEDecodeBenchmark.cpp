@@ -0,0 +1,109 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "BLTE.h"
+#include "utils/Inflate.h"
+
+// Decode throughput of the inflate backend on files shaped like a game install: mostly small files
+// that are a single 'Z' chunk, some mid-sized ones and a few large ones split into 256 KB chunks.
+// Build once per TACT_INFLATE_BACKEND and compare the output.
+// Usage: BLTEDecodeBenchmark [decoded MB, default 64]
+
+namespace {
+    struct SizeClass {
+        const char* name;
+        size_t      minSize;
+        size_t      maxSize;
+        double      share;  // of the file count
+    };
+
+    constexpr SizeClass sizeClasses[] = {
+        {"small  (0.5-16 KB)",  512,         16 * 1024,       0.60},
+        {"medium (16-256 KB)",  16 * 1024,   256 * 1024,      0.32},
+        {"large  (0.25-4 MB)",  256 * 1024,  4 * 1024 * 1024, 0.08},
+    };
+
+    std::vector<uint8_t> MakeInput(size_t size, std::mt19937& rng) {
+        static const char* words[] = {"Creature", "Spell", "Item", "Display", "Texture", "Model", "Sound",
+                                      "Map", "Area", "Quest", "0", "1", "255", "_", ".m2", ".blp", "\n"};
+        std::uniform_int_distribution<size_t> pick(0, std::size(words) - 1);
+        std::uniform_int_distribution<int> noise(0, 255);
+        std::vector<uint8_t> input;
+        input.reserve(size);
+        while (input.size() < size) {
+            // Some binary noise in between, so it doesn't compress better than real data
+            if (pick(rng) == 0) {
+                input.push_back(static_cast<uint8_t>(noise(rng)));
+                continue;
+            }
+            const char* word = words[pick(rng)];
+            input.insert(input.end(), word, word + std::char_traits<char>::length(word));
+        }
+        input.resize(size);
+        return input;
+    }
+
+    struct File {
+        std::vector<uint8_t> blob;
+        size_t decodedSize;
+    };
+}
+
+int main(int argc, char** argv) {
+    size_t totalSize = (argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 64) * 1024 * 1024;
+    std::mt19937 rng(7);
+
+    std::printf("Inflate backend: %s\n", Inflate::BackendName());
+    std::printf("%-20s %7s %8s %10s %12s\n", "files", "count", "chunks", "MB/s", "ns/chunk");
+
+    double allBytes = 0, allNs = 0;
+    for (const auto& sizeClass : sizeClasses) {
+        // Each class gets its share of the decoded bytes, weighted by the average file size
+        double averageSize = (sizeClass.minSize + sizeClass.maxSize) / 2.0;
+        double weight = 0;
+        for (const auto& other : sizeClasses)
+            weight += other.share * (other.minSize + other.maxSize) / 2.0;
+        size_t classBytes = static_cast<size_t>(totalSize * sizeClass.share * averageSize / weight);
+
+        std::uniform_int_distribution<size_t> sizes(sizeClass.minSize, sizeClass.maxSize);
+        std::vector<File> files;
+        size_t chunks = 0, bytes = 0;
+        while (bytes < classBytes) {
+            auto input = MakeInput(sizes(rng), rng);
+            auto blob = BLTE::Encode(input);
+            chunks += BLTE::ParseHeader(blob.data(), blob.size()).chunks.size();
+            bytes += input.size();
+            files.push_back({std::move(blob), input.size()});
+        }
+
+        // Serial decode on this thread, the backend is all that differs between builds
+        BLTEDecodeOptions options;
+        options.parallelThreshold = 0;
+        std::vector<uint8_t> out(sizeClass.maxSize);
+        double best = 0;
+        for (int round = 0; round < 5; ++round) {
+            auto start = std::chrono::steady_clock::now();
+            for (const auto& file : files) {
+                if (BLTE::Decode(file.blob, std::span<uint8_t>(out.data(), file.decodedSize), options) != file.decodedSize)
+                    throw std::runtime_error("short decode");
+            }
+            double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            if (round == 0 || ns < best)
+                best = ns;
+        }
+
+        allBytes += bytes;
+        allNs += best;
+        std::printf("%-20s %7zu %8zu %10.0f %12.0f\n", sizeClass.name, files.size(), chunks,
+                    bytes / (best / 1e9) / (1024 * 1024), best / chunks);
+    }
+    std::printf("%-20s %7s %8s %10.0f\n", "all", "", "", allBytes / (allNs / 1e9) / (1024 * 1024));
+    return 0;
+}
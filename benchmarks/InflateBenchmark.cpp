@@ -0,0 +1,104 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+#include "utils/Inflate.h"
+
+// Many small 'Z' chunks, where setting up an inflate state for every chunk costs about as much as
+// inflating it. Compares that against Inflate::Decompress, which reuses one state per thread.
+// Usage: InflateBenchmark [decoded MB per chunk size, default 16]
+
+namespace {
+    struct Chunk {
+        std::vector<uint8_t> compressed;
+        size_t decodedSize;
+    };
+
+    // Text-like input that compresses to about a third, like most game data does
+    std::vector<uint8_t> MakeInput(size_t size, std::mt19937& rng) {
+        static const char* words[] = {"Creature", "Spell", "Item", "Display", "Texture", "Model", "Sound",
+                                      "Map", "Area", "Quest", "0", "1", "255", "_", ".m2", ".blp", "\n"};
+        std::uniform_int_distribution<size_t> pick(0, std::size(words) - 1);
+        std::vector<uint8_t> input;
+        input.reserve(size);
+        while (input.size() < size) {
+            const char* word = words[pick(rng)];
+            input.insert(input.end(), word, word + std::char_traits<char>::length(word));
+        }
+        input.resize(size);
+        return input;
+    }
+
+    std::vector<Chunk> MakeChunks(size_t chunkSize, size_t totalSize, std::mt19937& rng) {
+        std::vector<Chunk> chunks;
+        for (size_t done = 0; done < totalSize; done += chunkSize) {
+            auto input = MakeInput(chunkSize, rng);
+            uLongf compressedSize = compressBound(static_cast<uLong>(input.size()));
+            Chunk chunk{std::vector<uint8_t>(compressedSize), input.size()};
+            if (compress2(chunk.compressed.data(), &compressedSize, input.data(), static_cast<uLong>(input.size()), 6) != Z_OK)
+                throw std::runtime_error("compress2 failed");
+            chunk.compressed.resize(compressedSize);
+            chunks.push_back(std::move(chunk));
+        }
+        return chunks;
+    }
+
+    // What every chunk paid before the state was kept per thread
+    bool InflateFresh(const Chunk& chunk, uint8_t* out) {
+        z_stream stream{};
+        if (inflateInit(&stream) != Z_OK)
+            return false;
+        stream.next_in   = const_cast<Bytef*>(chunk.compressed.data());
+        stream.avail_in  = static_cast<uInt>(chunk.compressed.size());
+        stream.next_out  = out;
+        stream.avail_out = static_cast<uInt>(chunk.decodedSize);
+        bool ok = inflate(&stream, Z_FINISH) == Z_STREAM_END && stream.avail_out == 0;
+        inflateEnd(&stream);
+        return ok;
+    }
+
+    template<typename Fn>
+    double NsPerChunk(const std::vector<Chunk>& chunks, std::vector<uint8_t>& out, Fn&& inflateChunk) {
+        // Best of a few rounds, the first also warms up caches and the thread's state
+        double best = 0;
+        for (int round = 0; round < 5; ++round) {
+            auto start = std::chrono::steady_clock::now();
+            for (const auto& chunk : chunks) {
+                if (!inflateChunk(chunk, out.data()))
+                    throw std::runtime_error("inflate failed");
+            }
+            double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            if (round == 0 || ns < best)
+                best = ns;
+        }
+        return best / chunks.size();
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t totalSize = (argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 16) * 1024 * 1024;
+    std::mt19937 rng(42);
+
+    std::printf("Inflate backend: %s\n", Inflate::BackendName());
+    std::printf("chunk size   chunks   per-chunk init   reused state   speedup\n");
+    for (size_t chunkSize : {256, 1024, 4096, 16384, 65536}) {
+        auto chunks = MakeChunks(chunkSize, totalSize, rng);
+        std::vector<uint8_t> out(chunkSize);
+
+        double fresh = NsPerChunk(chunks, out, InflateFresh);
+        double reused = NsPerChunk(chunks, out, [](const Chunk& chunk, uint8_t* dest) {
+            return Inflate::Decompress(chunk.compressed.data(), chunk.compressed.size(), dest, chunk.decodedSize);
+        });
+
+        std::printf("%10zu %8zu %13.0f ns %11.0f ns %8.2fx\n", chunkSize, chunks.size(), fresh, reused, fresh / reused);
+    }
+    return 0;
+}
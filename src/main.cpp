@@ -217,6 +217,7 @@ int main(int argc, char* argv[]) {
           ("i,inputvalue" , "Input value",   cxxopts::value<std::string>())
           ("o,output"     , "Output path",   cxxopts::value<std::string>())
           ("d,basedir"    , "Base install dir", cxxopts::value<std::string>())
+          ("mirror"       , "Local CDN mirror dir", cxxopts::value<std::string>())
           ("h,help", "Print help");
         auto res = opts.parse(argc, argv);
         if (res.count("help")) {
@@ -231,6 +232,7 @@ int main(int argc, char* argv[]) {
         if (res.count("locale"))     build.GetSettings()->Locale      = RootInstance::StringToLocaleFlag.at(res["locale"].as<std::string>());
         if (res.count("inputvalue")) Input  = res["inputvalue"].as<std::string>();
         if (res.count("output"))     Output = res["output"].as<std::string>();
+        if (res.count("mirror"))     build.GetCDN()->SetMirror(res["mirror"].as<std::string>());
 
         if (res.count("mode")) {
             auto m = res["mode"].as<std::string>();
@@ -320,21 +322,39 @@ int main(int argc, char* argv[]) {
         std::cout << "Extracting " << extractionTargets.size()
                   << " file" << (extractionTargets.size()>1?"s":"") << "..\n";
 
+        // Fetch archived files that sit close together with shared range requests, the extraction below
+        // then reads them from the cache
+        if (extractionTargets.size() > 1) {
+            std::vector<std::vector<uint8_t>> eKeys;
+            eKeys.reserve(extractionTargets.size());
+            for (const auto& t : extractionTargets)
+                eKeys.push_back(t.eKey);
+
+            try {
+                build.PrefetchFilesByEKey(eKeys);
+            } catch (std::exception& e) {
+                std::cerr << "Prefetch failed, falling back to per-file downloads: " << e.what() << "\n";
+            }
+        }
+
         // Parallel extract
         std::for_each(std::execution::par, extractionTargets.begin(), extractionTargets.end(),
             [&](auto &t){
                 auto hex = toHexLower(t.eKey);
                 std::cout << "Extracting " << hex
                           << " to " << t.fileName << std::endl;;
+                fs::path out = t.fileName;
                 try {
-                    auto data = build.OpenFileByEKey(t.eKey, t.decodedSize);
-                    fs::path out = t.fileName;
                     if (!out.parent_path().empty()) {
                         fs::create_directories(out.parent_path());
                     }
                     std::ofstream ofs(out, std::ios::binary);
-                    ofs.write(reinterpret_cast<const char*>(data.data()), data.size());
+                    build.StreamFileByEKey(t.eKey, [&](const uint8_t* data, size_t size) {
+                        ofs.write(reinterpret_cast<const char*>(data), size);
+                    }, t.decodedSize);
                 } catch (std::exception& e) {
+                    std::error_code ec;
+                    fs::remove(out, ec);
                     std::cerr << "Failed to extract " << t.fileName
                               << " (" << hex << "): " << e.what() << "\n";
                 }
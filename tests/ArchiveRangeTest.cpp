@@ -0,0 +1,87 @@
+#include <string>
+#include <vector>
+
+#include "CDN.h"
+#include "HttpStandIn.h"
+#include "TestUtils.h"
+
+namespace {
+    const std::string archive = "0123456789abcdef0123456789abcdef";
+    const std::string eKey    = "fedcba9876543210fedcba9876543210";
+
+    // Single-block BLTE: no chunk table, one 'N' block holding payload as is
+    std::vector<uint8_t> SingleBlock(const std::string& payload) {
+        std::vector<uint8_t> blob = {'B', 'L', 'T', 'E', 0, 0, 0, 0, 'N'};
+        blob.insert(blob.end(), payload.begin(), payload.end());
+        return blob;
+    }
+
+    std::string ToString(const std::vector<uint8_t>& data) {
+        return {data.begin(), data.end()};
+    }
+
+    // Serves blob at offset inside an archive and reads [rangeOffset, rangeOffset + rangeLength) of it
+    std::vector<uint8_t> ReadRange(HttpStandIn& server, const TempDir& cacheDir, const std::vector<uint8_t>& blob,
+                                   size_t offset, uint64_t rangeOffset, uint64_t rangeLength, uint64_t decodedSize) {
+        std::vector<uint8_t> archiveData(offset, 0xAA);
+        archiveData.insert(archiveData.end(), blob.begin(), blob.end());
+        archiveData.resize(archiveData.size() + 100, 0xBB);
+        server.Serve("/tpr/wow/data/01/23/" + archive, archiveData);
+
+        Settings settings;
+        settings.CacheDir = cacheDir.Path();
+        CDN cdn(std::make_shared<Settings>(settings));
+        cdn.setProductDirectory("tpr/wow");
+        cdn.SetCDNs({server.Host()});
+        return cdn.GetFileRangeFromArchive(eKey, archive, offset, blob.size(), rangeOffset, rangeLength, decodedSize);
+    }
+}
+
+// A single-block entry that fits the header probe needs exactly one request
+void SmallSingleBlockEntry() {
+    HttpStandIn server;
+    TempDir cacheDir("tact-archive-range");
+    std::string payload = "a small archive entry";
+    auto blob = SingleBlock(payload);
+
+    std::vector<uint8_t> decoded;
+    try {
+        decoded = ReadRange(server, cacheDir, blob, 50, 8, 7, payload.size());
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+    }
+    CHECK(ToString(decoded) == "archive");
+
+    auto gets = server.Gets();
+    CHECK(gets.size() == 1);
+    if (!gets.empty())
+        CHECK(gets[0].range == "bytes=50-" + std::to_string(50 + blob.size() - 1));
+}
+
+// One that doesn't is completed with a second request for the remainder
+void LargeSingleBlockEntry() {
+    HttpStandIn server;
+    TempDir cacheDir("tact-archive-range");
+    std::string payload(6000, 'x');
+    payload.replace(5000, 5, "match");
+    auto blob = SingleBlock(payload);
+
+    std::vector<uint8_t> decoded;
+    try {
+        decoded = ReadRange(server, cacheDir, blob, 10, 5000, 5, payload.size());
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+    }
+    CHECK(ToString(decoded) == "match");
+
+    auto gets = server.Gets();
+    CHECK(gets.size() == 2);
+    if (gets.size() == 2)
+        CHECK(gets[1].range == "bytes=4106-" + std::to_string(10 + blob.size() - 1));
+}
+
+int main() {
+    SmallSingleBlockEntry();
+    LargeSingleBlockEntry();
+    return TestResult();
+}
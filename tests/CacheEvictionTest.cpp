@@ -0,0 +1,104 @@
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CDN.h"
+#include "CacheManager.h"
+#include "HttpStandIn.h"
+#include "TestUtils.h"
+
+namespace {
+    void WriteFile(const std::filesystem::path& path, size_t size) {
+        std::filesystem::create_directories(path.parent_path());
+        std::ofstream out(path, std::ios::binary);
+        out << std::string(size, 'x');
+    }
+
+    // Access times have millisecond resolution
+    void Tick() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+}
+
+// Pinned files are skipped, for good or until their owner is gone
+void EvictionSkipsPinned() {
+    TempDir dir("tact-cache-eviction");
+    CacheManager cache(dir.Path(), 2500, [](const std::filesystem::path& path) {
+        return std::filesystem::remove(path);
+    });
+
+    for (const char* name : {"a", "b"}) {
+        WriteFile(dir.Path() / name, 1000);
+        cache.Added(dir.Path() / name);
+        Tick();
+    }
+    auto owner = std::make_shared<int>(0);
+    cache.Pin(dir.Path() / "a");
+    cache.Pin(dir.Path() / "b", owner);
+
+    // Over budget, but the only candidates are pinned
+    WriteFile(dir.Path() / "c", 1000);
+    cache.Added(dir.Path() / "c");
+    CHECK(std::filesystem::exists(dir.Path() / "a"));
+    CHECK(std::filesystem::exists(dir.Path() / "b"));
+    Tick();
+
+    WriteFile(dir.Path() / "d", 1000);
+    cache.Added(dir.Path() / "d");
+    CHECK(std::filesystem::exists(dir.Path() / "a"));
+    CHECK(std::filesystem::exists(dir.Path() / "b"));
+    CHECK(!std::filesystem::exists(dir.Path() / "c"));
+
+    owner.reset();
+    Tick();
+    WriteFile(dir.Path() / "e", 1000);
+    cache.Added(dir.Path() / "e");
+    CHECK(std::filesystem::exists(dir.Path() / "a"));
+    CHECK(!std::filesystem::exists(dir.Path() / "b"));
+}
+
+// Files the CDN hands out by path or as a mapping survive eviction
+void HandedOutFilesSurvive() {
+    HttpStandIn server;
+    TempDir cacheDir("tact-cache-eviction");
+    auto keyOf = [](int i) { return std::string(30, '0') + std::to_string(10 + i); };
+    for (int i = 0; i < 8; ++i)
+        server.Serve("/tpr/wow/data/00/00/" + keyOf(i), std::vector<uint8_t>(1000, static_cast<uint8_t>('a' + i)));
+
+    Settings settings;
+    settings.CacheDir = cacheDir.Path();
+    settings.MaxCacheSize = 3500;
+    settings.HotObjectCacheSize = 0;
+    CDN cdn(std::make_shared<Settings>(settings));
+    cdn.setProductDirectory("tpr/wow");
+    cdn.SetCDNs({server.Host()});
+
+    try {
+        auto mapped = cdn.GetFileMapped("data", keyOf(0), 1000);
+        Tick();
+        auto path = cdn.GetFilePath("data", keyOf(1), 1000);
+        Tick();
+        for (int i = 2; i < 8; ++i) {
+            cdn.GetFile("data", keyOf(i), 1000);
+            Tick();
+        }
+
+        CHECK(std::filesystem::exists(cacheDir.Path() / "tpr" / "wow" / "data" / keyOf(0)));
+        CHECK(static_cast<const uint8_t*>(mapped->data())[999] == 'a');
+        CHECK(std::filesystem::exists(path));
+        CHECK(!std::filesystem::exists(cacheDir.Path() / "tpr" / "wow" / "data" / keyOf(2)));
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        CHECK(false);
+    }
+}
+
+int main() {
+    EvictionSkipsPinned();
+    HandedOutFilesSurvive();
+    return TestResult();
+}
@@ -0,0 +1,92 @@
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DownloadScheduler.h"
+#include "TestUtils.h"
+
+using namespace std::chrono_literals;
+
+// Threads block in AcquireSlot, give them time to get there
+constexpr auto settle = 100ms;
+
+// A freed slot goes to the highest priority waiter, whatever the order they arrived in
+void FreedSlotGoesToHighestPriority() {
+    DownloadScheduler scheduler(1, 1);
+    std::mutex orderMutex;
+    std::vector<std::string> order;
+
+    auto waiter = [&](DownloadPriority priority, std::string name) {
+        return std::async(std::launch::async, [&, priority, name] {
+            auto slot = scheduler.AcquireSlot("host", priority);
+            std::scoped_lock lock(orderMutex);
+            order.push_back(name);
+        });
+    };
+
+    std::vector<std::future<void>> waiters;
+    {
+        auto held = scheduler.AcquireSlot("host");
+        waiters.push_back(waiter(DownloadPriority::Bulk, "bulk"));
+        std::this_thread::sleep_for(settle);
+        waiters.push_back(waiter(DownloadPriority::Normal, "normal"));
+        std::this_thread::sleep_for(settle);
+        waiters.push_back(waiter(DownloadPriority::Metadata, "metadata"));
+        std::this_thread::sleep_for(settle);
+    }
+    for (auto& w : waiters)
+        w.get();
+
+    CHECK((order == std::vector<std::string>{"metadata", "normal", "bulk"}));
+}
+
+// A higher priority request waiting for a busy server doesn't hold back requests to other servers
+void OtherServersNotHeldBack() {
+    DownloadScheduler scheduler(4, 1);
+    auto held = scheduler.AcquireSlot("busy");
+    auto metadata = std::async(std::launch::async, [&] {
+        auto slot = scheduler.AcquireSlot("busy", DownloadPriority::Metadata);
+    });
+    std::this_thread::sleep_for(settle);
+
+    auto bulk = std::async(std::launch::async, [&] {
+        auto slot = scheduler.AcquireSlot("idle", DownloadPriority::Bulk);
+    });
+    CHECK(bulk.wait_for(2s) == std::future_status::ready);
+    CHECK(metadata.wait_for(0s) == std::future_status::timeout);
+
+    { auto release = std::move(held); }
+    CHECK(metadata.wait_for(2s) == std::future_status::ready);
+}
+
+// Requests of a job take its priority, a scope sets it for the calling thread
+void PriorityFollowsJobsAndScopes() {
+    DownloadScheduler scheduler(2, 2);
+    CHECK(DownloadScheduler::CurrentPriority() == DownloadPriority::Normal);
+
+    auto metadata = scheduler.Submit(DownloadPriority::Metadata, [] { return DownloadScheduler::CurrentPriority(); });
+    auto bulk = scheduler.Submit(DownloadPriority::Bulk, [] { return DownloadScheduler::CurrentPriority(); });
+    CHECK(metadata.get() == DownloadPriority::Metadata);
+    CHECK(bulk.get() == DownloadPriority::Bulk);
+
+    {
+        DownloadScheduler::PriorityScope outer(DownloadPriority::Metadata);
+        CHECK(DownloadScheduler::CurrentPriority() == DownloadPriority::Metadata);
+        {
+            DownloadScheduler::PriorityScope inner(DownloadPriority::Bulk);
+            CHECK(DownloadScheduler::CurrentPriority() == DownloadPriority::Bulk);
+        }
+        CHECK(DownloadScheduler::CurrentPriority() == DownloadPriority::Metadata);
+    }
+    CHECK(DownloadScheduler::CurrentPriority() == DownloadPriority::Normal);
+}
+
+int main() {
+    FreedSlotGoesToHighestPriority();
+    OtherServersNotHeldBack();
+    PriorityFollowsJobsAndScopes();
+    return TestResult();
+}
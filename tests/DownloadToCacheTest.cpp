@@ -0,0 +1,126 @@
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "CDN.h"
+#include "HttpStandIn.h"
+#include "TestUtils.h"
+
+namespace {
+    const std::string key = "00112233445566778899aabbccddeeff";
+    const std::string path = "/tpr/wow/data/00/11/" + key;
+
+    // 'N' chunks of 1 KB, so a byte flipped at a known offset lands in a known chunk
+    std::vector<uint8_t> MakeBlob(std::vector<uint8_t>& decoded) {
+        decoded.resize(8 * 1024);
+        for (size_t i = 0; i < decoded.size(); ++i)
+            decoded[i] = static_cast<uint8_t>(i * 7);
+        BLTEEncodeOptions options;
+        options.chunkSize = 1024;
+        options.compressionLevel = 0;
+        return BLTE::Encode(decoded, options);
+    }
+
+    struct Fixture {
+        HttpStandIn server;
+        TempDir cacheDir{"tact-download-to-cache"};
+        std::vector<uint8_t> decoded;
+        std::vector<uint8_t> blob = MakeBlob(decoded);
+        std::filesystem::path cachePath = cacheDir.Path() / "tpr" / "wow" / "data" / key;
+        std::filesystem::path partPath = cachePath.string() + ".part";
+        std::unique_ptr<CDN> cdn;
+
+        Fixture() {
+            Settings settings;
+            settings.CacheDir = cacheDir.Path();
+            settings.VerifyChecksums = true;
+            cdn = std::make_unique<CDN>(std::make_shared<Settings>(settings));
+            cdn->setProductDirectory("tpr/wow");
+            cdn->SetCDNs({server.Host()});
+        }
+
+        // Decodes the file through the cache, false if that threw
+        bool Stream(std::vector<uint8_t>& out) {
+            out.clear();
+            try {
+                cdn->StreamDecodedFile("data", key, [&](const uint8_t* data, size_t size) {
+                    out.insert(out.end(), data, data + size);
+                }, blob.size(), decoded.size());
+                return true;
+            } catch (const std::exception& e) {
+                std::cerr << "Expected: " << e.what() << std::endl;
+                return false;
+            }
+        }
+    };
+}
+
+// A transfer that drops midway keeps its bytes, the next attempt only asks for the rest
+void TransportFailureKeepsPart() {
+    Fixture f;
+    f.server.Serve(path, f.blob);
+    f.server.CutOff(path, 3000);
+
+    std::vector<uint8_t> out;
+    CHECK(!f.Stream(out));
+    CHECK(!std::filesystem::exists(f.cachePath));
+    CHECK(std::filesystem::exists(f.partPath) && std::filesystem::file_size(f.partPath) == 3000);
+
+    f.server.ClearCutOff(path);
+    CHECK(f.Stream(out));
+    CHECK(out == f.decoded);
+    CHECK(std::filesystem::exists(f.cachePath) && !std::filesystem::exists(f.partPath));
+
+    auto gets = f.server.Gets();
+    CHECK(!gets.empty() && gets.back().range == "bytes=3000-");
+}
+
+// Bytes the caller rejects are not kept for the next attempt
+void SinkFailureDropsPart() {
+    Fixture f;
+    auto corrupt = f.blob;
+    corrupt[corrupt.size() - 10] ^= 0xFF;
+    f.server.Serve(path, corrupt);
+
+    std::vector<uint8_t> out;
+    CHECK(!f.Stream(out));
+    CHECK(!std::filesystem::exists(f.cachePath));
+    CHECK(!std::filesystem::exists(f.partPath));
+
+    // Fixed on the server, downloaded again from the start
+    f.server.Serve(path, f.blob);
+    CHECK(f.Stream(out));
+    CHECK(out == f.decoded);
+    auto gets = f.server.Gets();
+    CHECK(gets.size() == 2 && gets.back().range.empty());
+}
+
+// So are resumed bytes the caller rejects when they are replayed
+void ReplayFailureDropsPart() {
+    Fixture f;
+    f.server.Serve(path, f.blob);
+
+    std::filesystem::create_directories(f.partPath.parent_path());
+    {
+        auto corrupt = f.blob;
+        corrupt[f.blob.size() / 2] ^= 0xFF;
+        std::ofstream part(f.partPath, std::ios::binary);
+        part.write(reinterpret_cast<const char*>(corrupt.data()), f.blob.size() - 100);
+    }
+
+    std::vector<uint8_t> out;
+    CHECK(!f.Stream(out));
+    CHECK(!std::filesystem::exists(f.partPath));
+    CHECK(f.server.Gets().empty());
+
+    CHECK(f.Stream(out));
+    CHECK(out == f.decoded);
+}
+
+int main() {
+    TransportFailureKeepsPart();
+    SinkFailureDropsPart();
+    ReplayFailureDropsPart();
+    return TestResult();
+}
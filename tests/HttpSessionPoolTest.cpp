@@ -0,0 +1,131 @@
+#include <string>
+#include <vector>
+
+#include "cpr/cpr.h"
+#include "CDN.h"
+#include "HttpSessionPool.h"
+#include "HttpStandIn.h"
+#include "TestUtils.h"
+
+namespace {
+    long Get(HttpSessionPool::Lease& session, const HttpStandIn& server, const std::string& path) {
+        session->SetUrl(cpr::Url{"http://" + server.Host() + path});
+        session->SetHeader(cpr::Header{});
+        return session->Get().status_code;
+    }
+}
+
+// Sessions handed back are reused, and so is their keep-alive connection
+void ReusesConnections() {
+    HttpStandIn server;
+    server.Serve("/file", std::vector<uint8_t>(1000, 'x'));
+    HttpSessionPool pool(4);
+
+    for (int i = 0; i < 5; ++i) {
+        auto session = pool.Acquire(server.Host());
+        CHECK(Get(session, server, "/file") == 200);
+    }
+    CHECK(server.RequestCount() == 5);
+    CHECK(server.Connections() == 1);
+    CHECK(pool.IdleCount(server.Host()) == 1);
+}
+
+// A discarded session is dropped with its connection, the next request connects again
+void DiscardsSessions() {
+    HttpStandIn server;
+    server.Serve("/file", std::vector<uint8_t>(10, 'x'));
+    HttpSessionPool pool(4);
+
+    {
+        auto session = pool.Acquire(server.Host());
+        CHECK(Get(session, server, "/file") == 200);
+        session.Discard();
+    }
+    CHECK(pool.IdleCount(server.Host()) == 0);
+
+    {
+        auto session = pool.Acquire(server.Host());
+        CHECK(Get(session, server, "/file") == 200);
+    }
+    CHECK(server.Connections() == 2);
+    CHECK(pool.IdleCount(server.Host()) == 1);
+}
+
+// Leases held at the same time get their own sessions, at most maxIdlePerServer go back to the pool
+void ChecksOutAndIn() {
+    HttpStandIn server;
+    HttpSessionPool pool(2);
+
+    {
+        std::vector<HttpSessionPool::Lease> leases;
+        for (int i = 0; i < 3; ++i)
+            leases.push_back(pool.Acquire(server.Host()));
+        CHECK(&*leases[0] != &*leases[1] && &*leases[1] != &*leases[2] && &*leases[0] != &*leases[2]);
+        CHECK(pool.IdleCount(server.Host()) == 0);
+    }
+    CHECK(pool.IdleCount(server.Host()) == 2);
+
+    // Checked out again, not created
+    cpr::Session* first;
+    {
+        auto lease = pool.Acquire(server.Host());
+        first = &*lease;
+        CHECK(pool.IdleCount(server.Host()) == 1);
+    }
+    {
+        auto lease = pool.Acquire(server.Host());
+        CHECK(&*lease == first);
+    }
+
+    // A moved-from lease hands nothing back
+    {
+        auto lease = pool.Acquire(server.Host());
+        auto moved = std::move(lease);
+    }
+    CHECK(pool.IdleCount(server.Host()) == 2);
+
+    // Pools are per server
+    CHECK(pool.IdleCount("127.0.0.1:1") == 0);
+
+    pool.Clear();
+    CHECK(pool.IdleCount(server.Host()) == 0);
+}
+
+// Consecutive CDN downloads from one host share a connection
+void CDNReusesConnections() {
+    HttpStandIn server;
+    TempDir cacheDir("tact-session-pool");
+    std::vector<std::string> keys = {"00112233445566778899aabbccddeeff", "0123456789abcdef0123456789abcdef",
+                                     "fedcba9876543210fedcba9876543210"};
+    for (const auto& key : keys)
+        server.Serve("/tpr/wow/data/" + key.substr(0, 2) + "/" + key.substr(2, 2) + "/" + key,
+                     std::vector<uint8_t>(5000, static_cast<uint8_t>(key[0])));
+
+    Settings settings;
+    settings.CacheDir = cacheDir.Path();
+    CDN cdn(std::make_shared<Settings>(settings));
+    cdn.setProductDirectory("tpr/wow");
+    cdn.SetCDNs({server.Host()});
+
+    for (const auto& key : keys) {
+        try {
+            CHECK(cdn.GetFile("data", key, 5000).size() == 5000);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            CHECK(false);
+        }
+    }
+
+    // The HEAD probe ranking a new host uses a connection of its own
+    size_t probes = server.Requests().size() - server.Gets().size();
+    CHECK(server.Gets().size() == keys.size());
+    CHECK(server.Connections() == probes + 1);
+}
+
+int main() {
+    ReusesConnections();
+    DiscardsSessions();
+    ChecksOutAndIn();
+    CDNReusesConnections();
+    return TestResult();
+}
@@ -0,0 +1,275 @@
+#ifndef HTTPSTANDIN_H
+#define HTTPSTANDIN_H
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Keep-alive HTTP/1.1 server on 127.0.0.1 serving files from memory, standing in for a CDN host.
+// Understands GET and HEAD with single "bytes=a-b" / "bytes=a-" ranges and counts what it was asked.
+class HttpStandIn {
+public:
+    struct Request {
+        std::string method;
+        std::string path;
+        std::string range;  // empty without a Range header
+    };
+
+    HttpStandIn() {
+        listenFd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+        int yes = 1;
+        ::setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        socklen_t len = sizeof(addr);
+        if (::bind(listenFd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            ::listen(listenFd_, 64) != 0 ||
+            ::getsockname(listenFd_, reinterpret_cast<sockaddr*>(&addr), &len) != 0)
+            throw std::runtime_error("HttpStandIn: can't listen on 127.0.0.1");
+        port_ = ntohs(addr.sin_port);
+
+        acceptThread_ = std::thread([this] { AcceptLoop(); });
+    }
+
+    ~HttpStandIn() {
+        stopping_ = true;
+        ::shutdown(listenFd_, SHUT_RDWR);
+        ::close(listenFd_);
+        acceptThread_.join();
+
+        std::vector<std::thread> connections;
+        {
+            std::scoped_lock lock(mutex_);
+            for (int fd : openFds_)
+                ::shutdown(fd, SHUT_RDWR);
+            connections.swap(connectionThreads_);
+        }
+        for (auto& thread : connections)
+            thread.join();
+    }
+
+    HttpStandIn(const HttpStandIn&) = delete;
+    HttpStandIn& operator=(const HttpStandIn&) = delete;
+
+    // "127.0.0.1:<port>", as handed to CDN::SetCDNs
+    std::string Host() const { return "127.0.0.1:" + std::to_string(port_); }
+    uint16_t Port() const { return port_; }
+
+    void Serve(const std::string& path, std::vector<uint8_t> body) {
+        std::scoped_lock lock(mutex_);
+        files_[path] = std::move(body);
+    }
+
+    // Responses for path send at most bytes of the body before the connection drops
+    void CutOff(const std::string& path, size_t bytes) {
+        std::scoped_lock lock(mutex_);
+        cutOffs_[path] = bytes;
+    }
+
+    void ClearCutOff(const std::string& path) {
+        std::scoped_lock lock(mutex_);
+        cutOffs_.erase(path);
+    }
+
+    // GETs of path are answered only after delay, to keep a transfer in flight
+    void Delay(const std::string& path, std::chrono::milliseconds delay) {
+        std::scoped_lock lock(mutex_);
+        delays_[path] = delay;
+    }
+
+    size_t Connections() const { return connections_; }
+    size_t RequestCount() const { return requestCount_; }
+
+    std::vector<Request> Requests() {
+        std::scoped_lock lock(mutex_);
+        return requests_;
+    }
+
+    // Requests other than the HEAD probes CDNServerRanking sends to new hosts
+    std::vector<Request> Gets() {
+        std::scoped_lock lock(mutex_);
+        std::vector<Request> gets;
+        std::copy_if(requests_.begin(), requests_.end(), std::back_inserter(gets),
+                     [](const Request& r) { return r.method == "GET"; });
+        return gets;
+    }
+
+private:
+    void AcceptLoop() {
+        while (!stopping_) {
+            int fd = ::accept(listenFd_, nullptr, nullptr);
+            if (fd < 0)
+                return;
+            ++connections_;
+            std::scoped_lock lock(mutex_);
+            openFds_.push_back(fd);
+            connectionThreads_.emplace_back([this, fd] { ServeConnection(fd); });
+        }
+    }
+
+    void ServeConnection(int fd) {
+        std::string buffer;
+        char chunk[4096];
+        while (true) {
+            // 1) Read until the end of the request head, bodies are never sent to us
+            size_t headEnd;
+            while ((headEnd = buffer.find("\r\n\r\n")) == std::string::npos) {
+                ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+                if (n <= 0) {
+                    Close(fd);
+                    return;
+                }
+                buffer.append(chunk, n);
+            }
+            std::string head = buffer.substr(0, headEnd);
+            buffer.erase(0, headEnd + 4);
+
+            // 2) Request line and the headers we care about
+            Request request;
+            size_t lineEnd = head.find("\r\n");
+            std::string line = head.substr(0, lineEnd);
+            size_t sp1 = line.find(' ');
+            size_t sp2 = line.find(' ', sp1 + 1);
+            request.method = line.substr(0, sp1);
+            request.path = line.substr(sp1 + 1, sp2 - sp1 - 1);
+            bool close = false;
+            for (size_t pos = lineEnd; pos != std::string::npos && pos < head.size();) {
+                size_t next = head.find("\r\n", pos + 2);
+                std::string header = head.substr(pos + 2, next == std::string::npos ? std::string::npos : next - pos - 2);
+                std::string lower = header;
+                std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+                if (lower.starts_with("range:"))
+                    request.range = Trim(header.substr(6));
+                else if (lower.starts_with("connection:") && Trim(lower.substr(11)) == "close")
+                    close = true;
+                pos = next;
+            }
+
+            std::vector<uint8_t> body;
+            bool found;
+            size_t cutOff = SIZE_MAX;
+            std::chrono::milliseconds delay{0};
+            {
+                std::scoped_lock lock(mutex_);
+                requests_.push_back(request);
+                auto it = files_.find(request.path);
+                found = it != files_.end();
+                if (found)
+                    body = it->second;
+                if (auto cut = cutOffs_.find(request.path); cut != cutOffs_.end())
+                    cutOff = cut->second;
+                if (auto wait = delays_.find(request.path); wait != delays_.end() && request.method == "GET")
+                    delay = wait->second;
+            }
+            ++requestCount_;
+            std::this_thread::sleep_for(delay);
+
+            // 3) Respond, keeping the connection open unless asked not to
+            std::string status = "200 OK";
+            std::string extra;
+            size_t from = 0, to = body.size();
+            if (!found) {
+                status = "404 Not Found";
+                body.clear();
+                to = 0;
+            } else if (!request.range.empty()) {
+                if (!ParseRange(request.range, body.size(), from, to)) {
+                    status = "416 Range Not Satisfiable";
+                    extra = "Content-Range: bytes */" + std::to_string(body.size()) + "\r\n";
+                    from = to = 0;
+                } else {
+                    status = "206 Partial Content";
+                    extra = "Content-Range: bytes " + std::to_string(from) + "-" + std::to_string(to - 1) + "/" +
+                            std::to_string(body.size()) + "\r\n";
+                }
+            }
+
+            std::string response = "HTTP/1.1 " + status + "\r\nContent-Length: " + std::to_string(to - from) +
+                                   "\r\n" + extra + (close ? "Connection: close\r\n" : "") + "\r\n";
+            if (request.method != "HEAD") {
+                if (to - from > cutOff) {
+                    to = from + cutOff;
+                    close = true;
+                }
+                response.append(reinterpret_cast<const char*>(body.data()) + from, to - from);
+            }
+            if (!SendAll(fd, response) || close) {
+                Close(fd);
+                return;
+            }
+        }
+    }
+
+    static bool ParseRange(const std::string& range, size_t size, size_t& from, size_t& to) {
+        if (!range.starts_with("bytes="))
+            return false;
+        size_t dash = range.find('-');
+        if (dash == std::string::npos || dash == 6)
+            return false;
+        uint64_t first = std::stoull(range.substr(6, dash - 6));
+        uint64_t last = dash + 1 < range.size() ? std::stoull(range.substr(dash + 1)) : size - 1;
+        if (first > last || first >= size)
+            return false;
+        from = first;
+        to = std::min<uint64_t>(last + 1, size);
+        return true;
+    }
+
+    static std::string Trim(std::string s) {
+        s.erase(0, s.find_first_not_of(" \t"));
+        s.erase(s.find_last_not_of(" \t") + 1);
+        return s;
+    }
+
+    static bool SendAll(int fd, const std::string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0)
+                return false;
+            sent += n;
+        }
+        return true;
+    }
+
+    void Close(int fd) {
+        std::scoped_lock lock(mutex_);
+        std::erase(openFds_, fd);
+        ::close(fd);
+    }
+
+    int listenFd_ = -1;
+    uint16_t port_ = 0;
+    std::atomic<bool> stopping_ = false;
+    std::atomic<size_t> connections_ = 0;
+    std::atomic<size_t> requestCount_ = 0;
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::vector<uint8_t>> files_;
+    std::unordered_map<std::string, size_t> cutOffs_;
+    std::unordered_map<std::string, std::chrono::milliseconds> delays_;
+    std::vector<Request> requests_;
+    std::vector<int> openFds_;
+    std::vector<std::thread> connectionThreads_;
+    std::thread acceptThread_;
+};
+
+#endif //HTTPSTANDIN_H
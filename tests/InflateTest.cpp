@@ -0,0 +1,90 @@
+#include <random>
+#include <span>
+#include <vector>
+
+#include <zlib.h>
+
+#include "BLTE.h"
+#include "utils/Inflate.h"
+#include "TestUtils.h"
+
+// Run under every TACT_INFLATE_BACKEND, the backends must agree on what they accept
+namespace {
+    std::vector<uint8_t> MakeInput(size_t size) {
+        std::mt19937 rng(static_cast<uint32_t>(size));
+        std::vector<uint8_t> input(size);
+        for (auto& b : input)
+            b = static_cast<uint8_t>('a' + rng() % 8);
+        return input;
+    }
+
+    std::vector<uint8_t> Compress(const std::vector<uint8_t>& input) {
+        uLongf size = compressBound(static_cast<uLong>(input.size()));
+        std::vector<uint8_t> out(size);
+        compress2(out.data(), &size, input.data(), static_cast<uLong>(input.size()), 6);
+        out.resize(size);
+        return out;
+    }
+
+    bool Decompress(const std::vector<uint8_t>& compressed, std::vector<uint8_t>& out) {
+        return Inflate::Decompress(compressed.data(), compressed.size(), out.data(), out.size());
+    }
+}
+
+void RoundTrips() {
+    for (size_t size : {1, 100, 4096, 65536, 1024 * 1024}) {
+        auto input = MakeInput(size);
+        auto compressed = Compress(input);
+        std::vector<uint8_t> out(size);
+        CHECK(Decompress(compressed, out));
+        CHECK(out == input);
+    }
+}
+
+void RejectsWrongSizes() {
+    auto input = MakeInput(4096);
+    auto compressed = Compress(input);
+
+    std::vector<uint8_t> shorter(input.size() - 1);
+    CHECK(!Decompress(compressed, shorter));
+
+    std::vector<uint8_t> longer(input.size() + 1);
+    CHECK(!Decompress(compressed, longer));
+}
+
+void RejectsCorruptStreams() {
+    auto input = MakeInput(4096);
+    auto compressed = Compress(input);
+    std::vector<uint8_t> out(input.size());
+
+    auto badChecksum = compressed;
+    badChecksum.back() ^= 0xFF;
+    CHECK(!Decompress(badChecksum, out));
+
+    auto truncated = compressed;
+    truncated.resize(truncated.size() / 2);
+    CHECK(!Decompress(truncated, out));
+}
+
+void DecodesBLTE() {
+    auto input = MakeInput(300 * 1024);
+    BLTEEncodeOptions encodeOptions;
+    encodeOptions.chunkSize = 4096;
+    auto blob = BLTE::Encode(input, encodeOptions);
+
+    BLTEDecodeOptions decodeOptions;
+    decodeOptions.verifyChecksums = true;
+    CHECK(BLTE::Decode(blob, 0, decodeOptions) == input);
+
+    decodeOptions.parallelThreshold = 1;
+    CHECK(BLTE::Decode(blob, 0, decodeOptions) == input);
+}
+
+int main() {
+    std::cout << "Inflate backend: " << Inflate::BackendName() << std::endl;
+    RoundTrips();
+    RejectsWrongSizes();
+    RejectsCorruptStreams();
+    DecodesBLTE();
+    return TestResult();
+}
@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "BLTE.h"
+#include "CASCIndexInstance.h"
+#include "CDN.h"
+#include "HttpStandIn.h"
+#include "TestUtils.h"
+
+namespace {
+    using Key = std::array<uint8_t, 16>;
+
+    std::string Hex(const Key& key) {
+        std::string hex;
+        char byte[3];
+        for (uint8_t b : key) {
+            std::snprintf(byte, sizeof(byte), "%02x", b);
+            hex += byte;
+        }
+        return hex;
+    }
+
+    uint8_t Bucket(const Key& key) {
+        uint8_t i = 0;
+        for (int idx = 0; idx < 9; ++idx)
+            i ^= key[idx];
+        return (i & 0xF) ^ (i >> 4);
+    }
+
+    void Write(const std::filesystem::path& path, const std::vector<uint8_t>& data) {
+        std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(data.data()), data.size());
+    }
+
+    // data.000 and one bucket .idx as the client writes them: every record is a 0x1E byte header
+    // followed by the BLTE blob, the index points at the header and counts it into the size
+    struct LocalInstall {
+        TempDir baseDir{"tact-local-install"};
+        std::filesystem::path dataDir = baseDir.Path() / "Data" / "data";
+        std::vector<uint8_t> archive = std::vector<uint8_t>(100, 0xCC);
+        std::vector<std::pair<Key, std::pair<uint32_t, uint32_t>>> entries;  // key, (offset, size)
+
+        LocalInstall() { std::filesystem::create_directories(dataDir); }
+
+        void Add(const Key& key, const std::vector<uint8_t>& blob, const Key& headerKey, uint32_t headerSize) {
+            uint32_t offset = static_cast<uint32_t>(archive.size());
+            uint32_t size = static_cast<uint32_t>(LocalArchivePool::EntryHeaderSize + blob.size());
+            archive.insert(archive.end(), headerKey.rbegin(), headerKey.rend());
+            for (int shift = 0; shift < 32; shift += 8)
+                archive.push_back(static_cast<uint8_t>(headerSize >> shift));
+            archive.resize(offset + LocalArchivePool::EntryHeaderSize, 0);
+            archive.insert(archive.end(), blob.begin(), blob.end());
+            entries.emplace_back(key, std::make_pair(offset, size));
+        }
+
+        void Add(const Key& key, const std::vector<uint8_t>& blob) {
+            Add(key, blob, key, static_cast<uint32_t>(LocalArchivePool::EntryHeaderSize + blob.size()));
+        }
+
+        // All keys share one bucket, so one .idx holds them
+        void Finish() {
+            Write(dataDir / "data.000", archive);
+
+            std::sort(entries.begin(), entries.end());
+            IndexHeader header{};
+            header.version = 7;
+            header.bucketIndex = Bucket(entries[0].first);
+            header.entrySizeBytes = 4;
+            header.entryOffsetBytes = 5;
+            header.entryKeyBytes = 9;
+            header.entryOffsetBits = 30;
+            header.entriesSize = static_cast<uint32_t>(entries.size() * 18);
+
+            std::vector<uint8_t> index(sizeof(header));
+            std::memcpy(index.data(), &header, sizeof(header));
+            for (const auto& [key, location] : entries) {
+                index.insert(index.end(), key.begin(), key.begin() + 9);
+                index.push_back(0);  // archive 0, high bits of the offset
+                for (int shift = 24; shift >= 0; shift -= 8)
+                    index.push_back(static_cast<uint8_t>(location.first >> shift));
+                for (int shift = 0; shift < 32; shift += 8)
+                    index.push_back(static_cast<uint8_t>(location.second >> shift));
+            }
+            char name[16];
+            std::snprintf(name, sizeof(name), "%02x00000001.idx", header.bucketIndex);
+            Write(dataDir / name, index);
+        }
+    };
+
+    // Distinct keys of the same bucket, n is XORed into the bucket hash twice
+    Key MakeKey(uint8_t n) {
+        Key key{};
+        key[0] = 0x12;
+        key[1] = key[2] = n;
+        key[15] = n;
+        return key;
+    }
+
+    std::vector<uint8_t> Decoded(uint8_t seed) {
+        std::vector<uint8_t> data(20000);
+        for (size_t i = 0; i < data.size(); ++i)
+            data[i] = static_cast<uint8_t>((i / 64) * seed);
+        return data;
+    }
+
+    std::vector<uint8_t> Encode(const std::vector<uint8_t>& data) {
+        BLTEEncodeOptions options;
+        options.chunkSize = 4096;
+        return BLTE::Encode(data, options);
+    }
+
+    std::unique_ptr<CDN> MakeCDN(const HttpStandIn& server, const TempDir& cacheDir, const LocalInstall& install,
+                                 bool merge) {
+        Settings settings;
+        settings.CacheDir = cacheDir.Path();
+        settings.BaseDir = install.baseDir.Path();
+        settings.MergeLocalIndices = merge;
+        settings.HotObjectCacheSize = 0;
+        auto cdn = std::make_unique<CDN>(std::make_shared<Settings>(settings));
+        cdn->setProductDirectory("tpr/wow");
+        cdn->SetCDNs({server.Host()});
+        cdn->OpenLocal();
+        return cdn;
+    }
+}
+
+// A local entry decodes from the blob after its header, without asking the CDN
+void DecodesLocalEntry(bool merge) {
+    HttpStandIn server;
+    TempDir cacheDir("tact-local-cache");
+    LocalInstall install;
+    auto decoded = Decoded(3);
+    auto blob = Encode(decoded);
+    install.Add(MakeKey(1), Encode(Decoded(5)));
+    install.Add(MakeKey(2), blob);
+    install.Finish();
+    auto cdn = MakeCDN(server, cacheDir, install, merge);
+
+    try {
+        CHECK(cdn->GetFile("data", Hex(MakeKey(2)), blob.size()) == blob);
+        CHECK(cdn->GetFile("data", Hex(MakeKey(2)), blob.size(), decoded.size(), true) == decoded);
+
+        std::vector<uint8_t> streamed;
+        cdn->StreamDecodedFile("data", Hex(MakeKey(2)), [&](const uint8_t* data, size_t size) {
+            streamed.insert(streamed.end(), data, data + size);
+        }, blob.size(), decoded.size());
+        CHECK(streamed == decoded);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        CHECK(false);
+    }
+    CHECK(server.Gets().empty());
+}
+
+// A record whose header names another key or size is not used, the CDN serves it instead
+void MismatchedHeaderFallsBack() {
+    HttpStandIn server;
+    TempDir cacheDir("tact-local-cache-mismatch");
+    LocalInstall install;
+    auto decoded = Decoded(7);
+    auto blob = Encode(decoded);
+    install.Add(MakeKey(1), blob, MakeKey(9), static_cast<uint32_t>(LocalArchivePool::EntryHeaderSize + blob.size()));
+    install.Add(MakeKey(2), blob, MakeKey(2), 1234);
+    install.Finish();
+    for (uint8_t n : {1, 2}) {
+        auto key = Hex(MakeKey(n));
+        server.Serve("/tpr/wow/data/" + key.substr(0, 2) + "/" + key.substr(2, 2) + "/" + key, blob);
+    }
+    auto cdn = MakeCDN(server, cacheDir, install, false);
+
+    try {
+        CHECK(cdn->GetFile("data", Hex(MakeKey(1)), blob.size(), decoded.size(), true) == decoded);
+        CHECK(cdn->GetFile("data", Hex(MakeKey(2)), blob.size(), decoded.size(), true) == decoded);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        CHECK(false);
+    }
+    CHECK(server.Gets().size() == 2);
+}
+
+int main() {
+    DecodesLocalEntry(false);
+    DecodesLocalEntry(true);
+    MismatchedHeaderFallsBack();
+    return TestResult();
+}
@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "CDN.h"
+#include "HttpStandIn.h"
+#include "TestUtils.h"
+
+namespace {
+    size_t Probes(HttpStandIn& server) {
+        auto requests = server.Requests();
+        return std::count_if(requests.begin(), requests.end(), [](const auto& r) { return r.method == "HEAD"; });
+    }
+
+    std::shared_ptr<Settings> MakeSettings(const TempDir& cacheDir) {
+        Settings settings;
+        settings.CacheDir = cacheDir.Path();
+        return std::make_shared<Settings>(settings);
+    }
+}
+
+// Hosts are probed once when they are added, downloads don't probe
+void ProbesWhenAdded() {
+    HttpStandIn server;
+    TempDir cacheDir("tact-server-probe");
+    std::string key = "00112233445566778899aabbccddeeff";
+    server.Serve("/tpr/wow/data/00/11/" + key, std::vector<uint8_t>(100, 'x'));
+
+    CDN cdn(MakeSettings(cacheDir));
+    cdn.setProductDirectory("tpr/wow");
+    cdn.SetCDNs({server.Host()});
+    CHECK(Probes(server) == 1);
+
+    for (int i = 0; i < 3; ++i) {
+        try {
+            cdn.GetFile("data", key, 100);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            CHECK(false);
+        }
+    }
+    CHECK(Probes(server) == 1);
+    CHECK(server.Gets().size() == 1);  // the rest came from the hot object cache
+}
+
+// Hosts added before the product directory is known wait for it
+void ProbesOnProductDirectory() {
+    HttpStandIn server;
+    TempDir cacheDir("tact-server-probe");
+
+    CDN cdn(MakeSettings(cacheDir));
+    cdn.SetCDNs({server.Host()});
+    CHECK(Probes(server) == 0);
+
+    cdn.setProductDirectory("tpr/wow");
+    CHECK(Probes(server) == 1);
+    auto requests = server.Requests();
+    CHECK(!requests.empty() && requests[0].path == "/tpr/wow/");
+
+    // Known hosts aren't probed again
+    cdn.SetCDNs({server.Host()});
+    CHECK(Probes(server) == 1);
+}
+
+int main() {
+    ProbesWhenAdded();
+    ProbesOnProductDirectory();
+    return TestResult();
+}
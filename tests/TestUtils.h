@@ -0,0 +1,50 @@
+#ifndef TESTUTILS_H
+#define TESTUTILS_H
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+// Failed checks are reported and counted, a test's main returns TestResult()
+inline std::atomic<int> checkFailures = 0;
+
+#define CHECK(cond)                                                                                  \
+    do {                                                                                             \
+        if (!(cond)) {                                                                               \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK failed: " #cond << std::endl;      \
+            ++checkFailures;                                                                         \
+        }                                                                                            \
+    } while (0)
+
+inline int TestResult() {
+    if (checkFailures == 0)
+        std::cout << "All checks passed" << std::endl;
+    return checkFailures == 0 ? 0 : 1;
+}
+
+// Empty directory under the system temp directory, removed again with everything in it
+class TempDir {
+public:
+    explicit TempDir(const std::string& name) {
+        auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+        path_ = std::filesystem::temp_directory_path() / (name + "-" + std::to_string(stamp));
+        std::filesystem::create_directories(path_);
+    }
+
+    ~TempDir() {
+        std::error_code ec;
+        std::filesystem::remove_all(path_, ec);
+    }
+
+    TempDir(const TempDir&) = delete;
+    TempDir& operator=(const TempDir&) = delete;
+
+    const std::filesystem::path& Path() const { return path_; }
+
+private:
+    std::filesystem::path path_;
+};
+
+#endif //TESTUTILS_H
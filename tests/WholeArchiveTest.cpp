@@ -0,0 +1,120 @@
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CDN.h"
+#include "HttpStandIn.h"
+#include "TestUtils.h"
+
+namespace {
+    const std::string archive = "0123456789abcdef0123456789abcdef";
+    const std::string archivePath = "/tpr/wow/data/01/23/" + archive;
+
+    std::vector<uint8_t> MakeArchive() {
+        std::vector<uint8_t> data(1000);
+        for (size_t i = 0; i < data.size(); ++i)
+            data[i] = static_cast<uint8_t>(i * 13);
+        return data;
+    }
+
+    // The first range of 600 bytes already costs more than half of the 1000 byte archive
+    std::unique_ptr<CDN> MakeCDN(const HttpStandIn& server, const TempDir& cacheDir) {
+        Settings settings;
+        settings.CacheDir = cacheDir.Path();
+        settings.HotObjectCacheSize = 0;
+        settings.WholeArchiveThreshold = 0.5;
+        settings.WholeArchiveMinRanges = 1;
+        settings.WholeArchiveRequestCost = 0;
+        auto cdn = std::make_unique<CDN>(std::make_shared<Settings>(settings));
+        cdn->setProductDirectory("tpr/wow");
+        cdn->SetCDNs({server.Host()});
+        return cdn;
+    }
+
+    std::vector<uint8_t> Slice(const std::vector<uint8_t>& data, size_t offset, size_t size) {
+        return {data.begin() + offset, data.begin() + offset + size};
+    }
+
+    // Same stripe pick as CDN::FileLock
+    size_t Stripe(const std::filesystem::path& path) {
+        return std::hash<std::string>{}(path.lexically_normal().string()) % 1024;
+    }
+}
+
+// Once enough was asked from an archive it is fetched in one request, later entries need none
+void FetchedOnceWhole() {
+    HttpStandIn server;
+    TempDir cacheDir("tact-whole-archive");
+    auto archiveData = MakeArchive();
+    server.Serve(archivePath, archiveData);
+    auto cdn = MakeCDN(server, cacheDir);
+
+    try {
+        CHECK(cdn->GetFileFromArchive("aa00000000000000000000000000000a", archive, 100, 600) == Slice(archiveData, 100, 600));
+        CHECK(cdn->GetFileFromArchive("bb00000000000000000000000000000b", archive, 700, 300) == Slice(archiveData, 700, 300));
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        CHECK(false);
+    }
+
+    auto gets = server.Gets();
+    CHECK(gets.size() == 1);
+    CHECK(!gets.empty() && gets[0].path == archivePath && gets[0].range.empty());
+    CHECK(std::filesystem::file_size(cacheDir.Path() / "tpr" / "wow" / "data" / archive) == archiveData.size());
+}
+
+// A file whose lock stripe is shared with the archive doesn't wait for the archive's download
+void UnrelatedFilesDontWait() {
+    HttpStandIn server;
+    TempDir cacheDir("tact-whole-archive-stripe");
+    auto archiveData = MakeArchive();
+    server.Serve(archivePath, archiveData);
+    server.Delay(archivePath, std::chrono::milliseconds(2000));
+
+    auto dataDir = cacheDir.Path() / "tpr" / "wow" / "data";
+    size_t archiveStripe = Stripe(dataDir / archive);
+    std::string key;
+    for (int i = 0; key.empty(); ++i) {
+        auto candidate = std::format("{:032x}", i);
+        if (Stripe(dataDir / candidate) == archiveStripe)
+            key = candidate;
+    }
+    server.Serve("/tpr/wow/data/" + key.substr(0, 2) + "/" + key.substr(2, 2) + "/" + key, {'k', 'e', 'y'});
+    auto cdn = MakeCDN(server, cacheDir);
+
+    std::vector<uint8_t> entry;
+    std::thread whole([&] {
+        try {
+            entry = cdn->GetFileFromArchive("aa00000000000000000000000000000a", archive, 100, 600);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+        }
+    });
+
+    // Wait for the archive's GET to be in flight
+    for (int i = 0; i < 200 && server.Gets().empty(); ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    CHECK(!server.Gets().empty());
+
+    auto start = std::chrono::steady_clock::now();
+    try {
+        CHECK(cdn->GetFile("data", key, 3) == std::vector<uint8_t>({'k', 'e', 'y'}));
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        CHECK(false);
+    }
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(1000));
+
+    whole.join();
+    CHECK(entry == Slice(archiveData, 100, 600));
+}
+
+int main() {
+    FetchedOnceWhole();
+    UnrelatedFilesDontWait();
+    return TestResult();
+}